@@ -0,0 +1,13 @@
+#pragma once
+
+#include "app.h"
+
+// bench_term.c: term_screen_row が返す画面（既定は空）
+extern ScreenCell bench_screen[TERM_ROWS][TERM_COLS];
+
+// bench_sdl.c: 何も描かない SDL。塗りつぶしとテクスチャ貼り付けの呼び出しだけ数える
+extern unsigned bench_sdl_fill_calls;
+extern unsigned bench_sdl_fill_rects;
+extern unsigned bench_sdl_copy_calls;
+extern unsigned long bench_sdl_copy_pixels;
+extern Uint32 bench_sdl_ticks;   // SDL_GetTicks の返す時刻（カーソルの点滅位相）
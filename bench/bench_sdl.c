@@ -0,0 +1,53 @@
+// ベンチ用の SDL（render.c をそのままリンクするための空の描画関数）。
+// テクスチャは中身の無いダミーを返し、塗りつぶしとテクスチャ貼り付けの回数・面積だけ数える
+#include "bench.h"
+
+unsigned bench_sdl_fill_calls;
+unsigned bench_sdl_fill_rects;
+unsigned bench_sdl_copy_calls;
+unsigned long bench_sdl_copy_pixels;
+Uint32 bench_sdl_ticks;
+
+static char bench_sdl_objs[64];
+static int bench_sdl_next;
+
+SDL_Texture *SDL_CreateTexture(SDL_Renderer *renderer, Uint32 format, int access, int w, int h) {
+  return (SDL_Texture*)&bench_sdl_objs[bench_sdl_next++ % (int)sizeof(bench_sdl_objs)];
+}
+
+void SDL_DestroyTexture(SDL_Texture *texture) {}
+const char *SDL_GetError(void) { return "bench"; }
+Uint32 SDL_GetTicks(void) { return bench_sdl_ticks; }
+int SDL_RenderClear(SDL_Renderer *renderer) { return 0; }
+int SDL_RenderDrawLine(SDL_Renderer *renderer, int x1, int y1, int x2, int y2) { return 0; }
+int SDL_RenderDrawRect(SDL_Renderer *renderer, const SDL_Rect *rect) { return 0; }
+void SDL_RenderPresent(SDL_Renderer *renderer) {}
+int SDL_RenderSetViewport(SDL_Renderer *renderer, const SDL_Rect *rect) { return 0; }
+SDL_bool SDL_RenderTargetSupported(SDL_Renderer *renderer) { return SDL_TRUE; }
+int SDL_SetRenderDrawColor(SDL_Renderer *renderer, Uint8 r, Uint8 g, Uint8 b, Uint8 a) { return 0; }
+int SDL_SetRenderTarget(SDL_Renderer *renderer, SDL_Texture *texture) { return 0; }
+int SDL_SetTextureBlendMode(SDL_Texture *texture, SDL_BlendMode blendMode) { return 0; }
+
+int SDL_RenderGeometry(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Vertex *vertices, int num_vertices,
+                       const int *indices, int num_indices) {
+  return 0;
+}
+
+int SDL_RenderFillRect(SDL_Renderer *renderer, const SDL_Rect *rect) {
+  bench_sdl_fill_calls++;
+  bench_sdl_fill_rects++;
+  return 0;
+}
+
+int SDL_RenderFillRects(SDL_Renderer *renderer, const SDL_Rect *rects, int count) {
+  bench_sdl_fill_calls++;
+  bench_sdl_fill_rects += (unsigned)count;
+  return 0;
+}
+
+// dstrect が NULL なのは画面全体への貼り付け（frame_tex の表示）だけ
+int SDL_RenderCopy(SDL_Renderer *renderer, SDL_Texture *texture, const SDL_Rect *srcrect, const SDL_Rect *dstrect) {
+  bench_sdl_copy_calls++;
+  bench_sdl_copy_pixels += dstrect ? (unsigned long)dstrect->w * dstrect->h : (unsigned long)SCREEN_W * SCREEN_H;
+  return 0;
+}
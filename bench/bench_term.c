@@ -0,0 +1,32 @@
+// ベンチ用の term.c の代わり（term.c は SDL・PTY を引き込むのでリンクしない）
+#include "bench.h"
+#include "term.h"
+
+#include <string.h>
+
+// term.c と同じ
+uint8_t term_cell_attrs(const VTermScreenCell *cell) {
+  uint8_t a = 0;
+  if (cell->attrs.bold) a |= CELL_ATTR_BOLD;
+  if (cell->attrs.italic) a |= CELL_ATTR_ITALIC;
+  if (cell->attrs.underline == VTERM_UNDERLINE_DOUBLE) a |= CELL_ATTR_DUNDERLINE;
+  else if (cell->attrs.underline) a |= CELL_ATTR_UNDERLINE;
+  if (cell->attrs.strike) a |= CELL_ATTR_STRIKE;
+  if (cell->attrs.blink) a |= CELL_ATTR_BLINK;
+  if (cell->attrs.reverse) a |= CELL_ATTR_REVERSE;
+  return a;
+}
+
+ScreenCell bench_screen[TERM_ROWS][TERM_COLS];
+
+// 描画キャッシュは作らず、ベンチが用意した画面をそのまま返す
+const ScreenCell *term_screen_row(Session *s, int row) {
+  return bench_screen[row];
+}
+
+// 解析側の手間だけ term.c と揃える（汚れの印を行と一緒に動かす）
+void term_screen_move_rows(Session *s, int dst, int src, int n) {
+  if (n <= 0 || dst == src) return;
+  memmove(&s->screen_stale[dst], &s->screen_stale[src], (size_t)n);
+  memmove(&s->dirty_rows[dst], &s->dirty_rows[src], (size_t)n);
+}
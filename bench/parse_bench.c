@@ -0,0 +1,204 @@
+// PTY の出力を記録したファイルを libvterm に流し、解析段の速さを流し方ごとに比べる（make bench-parse）。
+// 画面のコールバックは session.c と同じく damage の印付けと scrollback への押し出しだけ。
+// 読み出しスレッドとロックは使わず、解析スレッドが握る区間（vterm_input_write と flush）だけを測る。
+// make bench-parse VTERM_BACKEND=state では grid.c をリンクし、本体と同じく VTermState から直接書く
+#include "grid.h"
+#include "scrollback.h"
+#include "term.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  size_t chunk;          // 一度に届く量（読み出し1回分）
+  size_t slice;          // vterm_input_write 1回に渡す上限
+  uint64_t budget_ns;    // 0 なら届いた分を流し切ってから flush
+} ParseMode;
+
+static const ParseMode modes[] = {
+  { "read512",  512,          512,             0 },                    // 512 バイト読むたびに flush
+  { "drain64k", PTY_READ_MAX, PTY_READ_MAX,    0 },                    // 溜まった分を一度に流して flush 1回
+  { "slice16k", PTY_READ_MAX, PTY_PARSE_SLICE, PTY_PARSE_BUDGET_NS },  // 今の解析スレッド（予算ごとに flush）
+};
+
+typedef struct {
+  uint64_t ns;
+  unsigned flushes;
+  unsigned pushes;
+  uint64_t push_ns;      // ns のうち scrollback への押し出し（sb_store_push + 詰め替え）
+} ParseResult;
+
+static int parse_load(const char *path, char **out, size_t *out_len);
+static ParseResult parse_run(const ParseMode *m, const char *buf, size_t len);
+static void parse_flush(Session *s);
+#ifndef GKD_VTERM_STATE_BACKEND
+static int parse_cb_damage(VTermRect rect, void *user);
+static int parse_cb_moverect(VTermRect dest, VTermRect src, void *user);
+static int parse_cb_sb_clear(void *user);
+static int parse_cb_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user);
+
+static const VTermScreenCallbacks parse_cb = {
+  .damage       = parse_cb_damage,
+  .moverect     = parse_cb_moverect,
+  .sb_clear     = parse_cb_sb_clear,
+  .sb_pushline4 = parse_cb_sb_pushline4,
+};
+#endif
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FILE   (例: script -q -c 'cat big.log' big.tty で取った端末出力)\n", argv[0]);
+    return 2;
+  }
+
+  char *buf;
+  size_t len;
+  if (parse_load(argv[1], &buf, &len) != 0) return 1;
+
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    const ParseMode *m = &modes[i];
+    ParseResult r = parse_run(m, buf, len);
+    printf("parse %-8s [%s]: %.1f MiB/s (%.1f MiB in %.0f ms) flushes=%u pushes=%u\n",
+           m->name, VTERM_BACKEND_NAME, (double)len / (1024.0 * 1024.0) / ((double)r.ns / 1e9), (double)len / (1024.0 * 1024.0),
+           (double)r.ns / 1e6, r.flushes, r.pushes);
+    printf("pushline %-8s [%s]: lines=%u %.0f ns/line share=%.1f%%\n",
+           m->name, VTERM_BACKEND_NAME, r.pushes, r.pushes ? (double)r.push_ns / r.pushes : 0.0,
+           r.ns ? 100.0 * (double)r.push_ns / (double)r.ns : 0.0);
+  }
+  free(buf);
+  return 0;
+}
+
+// 改行だけのファイル（cat する元のログ）は PTY と同じく \r\n に直す（onlcr）
+static int parse_load(const char *path, char **out, size_t *out_len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  size_t cap = 1 << 20, len = 0;
+  char *buf = malloc(cap);
+  int c, prev = 0;
+  while (buf && (c = fgetc(f)) != EOF) {
+    if (len + 2 > cap) {
+      char *nb = realloc(buf, cap * 2);
+      if (!nb) {
+        free(buf);
+        buf = NULL;
+        break;
+      }
+      buf = nb;
+      cap *= 2;
+    }
+    if (c == '\n' && prev != '\r') buf[len++] = '\r';
+    buf[len++] = (char)c;
+    prev = c;
+  }
+  fclose(f);
+  if (!buf) {
+    fprintf(stderr, "%s: out of memory\n", path);
+    return -1;
+  }
+  *out = buf;
+  *out_len = len;
+  return 0;
+}
+
+// session_init_vterm と同じ設定の端末に buf を m の流し方で全部流す（テーマは既定のまま）
+static ParseResult parse_run(const ParseMode *m, const char *buf, size_t len) {
+  static Session s;
+  static App app;
+  ParseResult r = {0};
+
+  memset(&s, 0, sizeof(s));
+  s.app = &app;
+  s.sb_spill_fd = -1;
+  sb_store_init(&s, 100000);
+
+  s.vt = vterm_new(TERM_ROWS, TERM_COLS);
+  vterm_set_utf8(s.vt, 1);
+#ifdef GKD_VTERM_STATE_BACKEND
+  s.vts_state = vterm_obtain_state(s.vt);
+  grid_attach(&s);
+  vterm_state_reset(s.vts_state, 1);
+#else
+  s.vts = vterm_obtain_screen(s.vt);
+  s.vts_state = vterm_obtain_state(s.vt);
+  vterm_screen_set_callbacks(s.vts, &parse_cb, &s);
+  vterm_screen_callbacks_has_pushline4(s.vts);
+  vterm_screen_set_damage_merge(s.vts, VTERM_DAMAGE_SCROLL);
+  vterm_screen_reset(s.vts, 1);
+#endif
+
+  uint64_t start = util_now_ns();
+  size_t off = 0;
+  while (off < len) {
+    size_t end = off + m->chunk < len ? off + m->chunk : len;
+    uint64_t t0 = util_now_ns();
+    while (off < end) {
+      size_t n = end - off < m->slice ? end - off : m->slice;
+      vterm_input_write(s.vt, buf + off, n);
+      off += n;
+      if (m->budget_ns && off < end && util_now_ns() - t0 >= m->budget_ns) {
+        parse_flush(&s);
+        r.flushes++;
+        t0 = util_now_ns();
+      }
+    }
+    parse_flush(&s);
+    r.flushes++;
+  }
+  r.ns = util_now_ns() - start;
+  r.pushes = (unsigned)atomic_load(&s.st_pushes);
+  r.push_ns = atomic_load(&s.st_push_ns);
+
+  vterm_free(s.vt);
+  sb_store_free(&s);
+  return r;
+}
+
+// state 版は damage を溜めないので flush するものが無い（session.c の解析スレッドと同じ）
+static void parse_flush(Session *s) {
+#ifndef GKD_VTERM_STATE_BACKEND
+  vterm_screen_flush_damage(s->vts);
+#endif
+}
+
+#ifndef GKD_VTERM_STATE_BACKEND
+static int parse_cb_damage(VTermRect rect, void *user) {
+  Session *s = (Session*)user;
+
+  int r0 = rect.start_row < 0 ? 0 : rect.start_row;
+  int r1 = rect.end_row > TERM_ROWS ? TERM_ROWS : rect.end_row;
+  for (int r = r0; r < r1; r++) s->dirty_rows[r] = s->screen_stale[r] = 1;
+  return 1;
+}
+
+static int parse_cb_moverect(VTermRect dest, VTermRect src, void *user) {
+  if (src.start_col != 0 || src.end_col != TERM_COLS || dest.start_col != 0 || dest.end_col != TERM_COLS) return 0;
+
+  term_screen_move_rows((Session*)user, dest.start_row, src.start_row, src.end_row - src.start_row);
+  return 1;
+}
+
+static int parse_cb_sb_clear(void *user) {
+  sb_store_clear((Session*)user);
+  return 1;
+}
+
+// session_cb_sb_pushline4 と同じく押し出しの時間を測る（state 版は grid.c の grid_push_row が測る）
+static int parse_cb_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user) {
+  Session *s = (Session*)user;
+  uint64_t t0 = util_now_ns();
+
+  ScrollbackCell *dst = sb_store_push(s, continuation);
+  if (dst) sb_line_pack(s, dst, cells, cols);
+
+  atomic_fetch_add_explicit(&s->st_push_ns, util_now_ns() - t0, memory_order_relaxed);
+  atomic_fetch_add_explicit(&s->st_pushes, 1, memory_order_relaxed);
+  return 1;
+}
+#endif
@@ -0,0 +1,194 @@
+// 背景の塗りつぶし回数と、カーソル点滅のフレームが描き直す面積を画面の種類ごとに数える（make bench-render）。
+// render.c をそのままリンクし、SDL は何も描かない bench_sdl.c で代用する。
+// 画面は htop・vim・ls --color を 53x13 に似せて組んだもので、実物の出力を取り込んだものではない
+#include "bench.h"
+#include "render.h"
+#include "scrollback.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  void (*build)(void);
+} RenderScreen;
+
+static void screen_ls(void);
+static void screen_vim(void);
+static void screen_htop(void);
+static void screen_text(int row, int col, const char *text, SDL_Color fg, SDL_Color bg, uint8_t attrs);
+static void screen_clear(void);
+
+static const RenderScreen screens[] = {
+  { "ls",   screen_ls },
+  { "vim",  screen_vim },
+  { "htop", screen_htop },
+};
+
+static const SDL_Color def_fg = { 229, 229, 229, 255 };
+static const SDL_Color def_bg = { 0, 0, 0, 255 };
+static const SDL_Color c_blue = { 0, 0, 238, 255 };
+static const SDL_Color c_green = { 0, 205, 0, 255 };
+static const SDL_Color c_cyan = { 0, 205, 205, 255 };
+static const SDL_Color c_yellow = { 205, 205, 0, 255 };
+static const SDL_Color c_red = { 205, 0, 0, 255 };
+
+static App app;
+static GlyphCacheEntry glyph = { .w = FONT_W, .h = FONT_H };
+static const KeyDefinition keys[KEY_LAYERS][KEY_ROWS][KEY_COLS];
+
+// 全行を描き直すフレームを1枚描き、端末領域の塗りつぶしを数える。
+// 以前の描画はセルごとに SDL_RenderFillRect を1回呼んでいたので、その回数は描いたセル数と同じ
+int main(void) {
+  Session *s = &app.sessions[0];
+  s->used = 1;
+  s->sb_spill_fd = -1;
+  s->app = &app;
+  sb_store_init(s, 1000);
+  app.renderer = (SDL_Renderer*)&app;
+  app.render.def_fg = def_fg;
+  app.render.def_bg = def_bg;
+  app.ui.layers = keys;
+
+  for (size_t i = 0; i < sizeof(screens) / sizeof(screens[0]); i++) {
+    screen_clear();
+    screens[i].build();
+
+    int cells = 0;
+    for (int r = 0; r < TERM_ROWS; r++) {
+      for (int c = 0; c < TERM_COLS; c++) cells += bench_screen[r][c].width != 0;
+    }
+
+    render_invalidate(&app);
+    memset(&app.stats, 0, sizeof(app.stats));
+    bench_sdl_fill_calls = bench_sdl_fill_rects = 0;
+    render_frame(&app, REDRAW_ALL);
+
+    printf("render %-4s: per-cell fills=%d -> fill_calls=%u fill_rects=%u (whole frame incl. status/cursor: %u calls)\n",
+           screens[i].name, cells, app.stats.fill_calls, app.stats.fill_rects, bench_sdl_fill_calls);
+
+    // カーソルの消灯と点灯を1回ずつ。画面全体への貼り付け（frame_tex の表示）は別に数える
+    for (int k = 1; k <= 2; k++) {
+      bench_sdl_ticks = (Uint32)k * CURSOR_BLINK_HALF_MS;
+      bench_sdl_fill_calls = bench_sdl_copy_calls = 0;
+      bench_sdl_copy_pixels = 0;
+      render_frame(&app, REDRAW_CURSOR);
+      unsigned long px = bench_sdl_copy_pixels % ((unsigned long)SCREEN_W * SCREEN_H);
+      unsigned present = (unsigned)(bench_sdl_copy_pixels / ((unsigned long)SCREEN_W * SCREEN_H));
+      printf("render %-4s: cursor %-3s frame: fill_calls=%u layer copies=%u (%lu px) + %u full-screen copy\n",
+             screens[i].name, k % 2 ? "off" : "on", bench_sdl_fill_calls, bench_sdl_copy_calls - present, px, present);
+    }
+    bench_sdl_ticks = 0;
+  }
+
+  sb_store_free(s);
+  return 0;
+}
+
+// ls -l --color: ディレクトリは青の太字、実行ファイルは緑。背景はすべて既定色
+static void screen_ls(void) {
+  static const char *names[] = { "assets", "bench", "build.sh", "GKDTerm.sh", "LICENSE.md", "Makefile",
+                                 "README.md", "src", "tools", "run.sh", "notes.txt", "libvterm" };
+  screen_text(0, 0, "total 48", def_fg, def_bg, 0);
+  for (int i = 0; i < 12; i++) {
+    const char *n = names[i];
+    int dir = strchr(n, '.') == NULL && strcmp(n, "Makefile") != 0;
+    int exe = strstr(n, ".sh") != NULL;
+    screen_text(i + 1, 0, dir ? "drwxr-xr-x 2 root root 4096 Oct 16 12:00 " : "-rw-r--r-- 1 root root 1234 Oct 16 12:00 ",
+                def_fg, def_bg, 0);
+    screen_text(i + 1, 41, n, dir ? c_blue : exe ? c_green : def_fg, def_bg, dir || exe ? CELL_ATTR_BOLD : 0);
+  }
+}
+
+// vim: 行番号（黄）、コードの一部に色、~ の行（青）、反転のステータス行
+static void screen_vim(void) {
+  static const char *code[] = { "#include \"app.h\"", "", "int main(void) {", "  App app;", "  app_init(&app);",
+                                "  app_run(&app);", "  return 0;", "}" };
+  for (int r = 0; r < 8; r++) {
+    char num[8];
+    snprintf(num, sizeof(num), "%3d ", r + 1);
+    screen_text(r, 0, num, c_yellow, def_bg, 0);
+    screen_text(r, 4, code[r], def_fg, def_bg, 0);
+  }
+  screen_text(0, 4, "#include", c_blue, def_bg, 0);
+  screen_text(2, 4, "int", c_green, def_bg, 0);
+  screen_text(6, 6, "return", c_yellow, def_bg, 0);
+  for (int r = 8; r < 11; r++) screen_text(r, 0, "~", c_blue, def_bg, 0);
+
+  char status[TERM_COLS + 1];
+  snprintf(status, sizeof(status), "%-38s%-15s", "main.c", "3,5  All");
+  screen_text(11, 0, status, def_fg, def_bg, CELL_ATTR_REVERSE);
+  screen_text(12, 0, "-- INSERT --", def_fg, def_bg, CELL_ATTR_BOLD);
+}
+
+// htop: メーター、緑背景の見出し、水色背景の選択行、F キーの帯（数字は既定色、名前は水色背景）
+static void screen_htop(void) {
+  screen_text(0, 0, "  1  [", def_fg, def_bg, 0);
+  screen_text(0, 6, "|||||||||", c_green, def_bg, 0);
+  screen_text(0, 15, "||||", c_red, def_bg, 0);
+  screen_text(0, 40, "25.3%]", def_fg, def_bg, 0);
+  screen_text(1, 0, "  Mem[", def_fg, def_bg, 0);
+  screen_text(1, 6, "||||||||||||", c_green, def_bg, 0);
+  screen_text(1, 34, "412M/1.94G]", def_fg, def_bg, 0);
+  screen_text(2, 0, "  Tasks: 42, 97 thr; 1 running", def_fg, def_bg, 0);
+
+  char head[TERM_COLS + 1];
+  snprintf(head, sizeof(head), "%-53s", "  PID USER      PRI  NI  VIRT   RES S CPU% Command");
+  screen_text(4, 0, head, (SDL_Color){ 0, 0, 0, 255 }, c_green, 0);
+  for (int r = 5; r < 12; r++) {
+    char proc[TERM_COLS + 1];
+    snprintf(proc, sizeof(proc), "%5d root       20   0  %3dM %4dM S %4.1f %-10s", 100 + r * 37, 10 + r, 2 + r,
+             (double)(12 - r), r == 6 ? "gkd_term" : "sh");
+    screen_text(r, 0, proc, def_fg, def_bg, 0);
+  }
+  char sel[TERM_COLS + 1];
+  snprintf(sel, sizeof(sel), "%-53s", "  322 root       20   0   16M   8M R 12.0 gkd_term");
+  screen_text(6, 0, sel, (SDL_Color){ 0, 0, 0, 255 }, c_cyan, 0);
+
+  static const char *labels[] = { "Help", "Setup", "Search", "Filter", "Tree", "Sort", "Kill" };
+  int col = 0;
+  for (int i = 0; i < 7 && col < TERM_COLS; i++) {
+    char f[4];
+    snprintf(f, sizeof(f), "F%d", i + 1);
+    screen_text(12, col, f, def_fg, def_bg, 0);
+    col += (int)strlen(f);
+    screen_text(12, col, labels[i], (SDL_Color){ 0, 0, 0, 255 }, c_cyan, 0);
+    col += (int)strlen(labels[i]);
+  }
+}
+
+static void screen_text(int row, int col, const char *text, SDL_Color fg, SDL_Color bg, uint8_t attrs) {
+  for (int i = 0; text[i] && col + i < TERM_COLS; i++) {
+    ScreenCell *cell = &bench_screen[row][col + i];
+    cell->ch = (unsigned char)text[i];
+    cell->fg = fg;
+    cell->bg = bg;
+    cell->attrs = attrs;
+  }
+}
+
+static void screen_clear(void) {
+  for (int r = 0; r < TERM_ROWS; r++) {
+    for (int c = 0; c < TERM_COLS; c++) {
+      bench_screen[r][c] = (ScreenCell){ .ch = ' ', .fg = def_fg, .bg = def_bg, .width = 1 };
+    }
+  }
+}
+
+// ---- render.c が呼ぶ他のモジュール（描画しないので空でよい） ----
+
+const GlyphCacheEntry *glyph_lookup(App *a, uint32_t cp, uint8_t style) { return &glyph; }
+SDL_Texture *glyph_atlas_texture(App *a, int page) { return (SDL_Texture*)&glyph; }
+void ui_draw_text_utf8(App *a, int x, int y, SDL_Color fg, const char *str) {}
+int ui_text_width_utf8(App *a, const char *str) { return (int)strlen(str) * FONT_W; }
+void ui_draw_key_button(App *a, int x0, int y0, int w, int h, const char *label, int selected) {}
+void ui_draw_session_menu_overlay(App *a, int ox, int oy) {}
+int ui_draw_mod_indicator(App *a, int x, int y, SDL_Color base, const char *icon, ModState st) { return x; }
+int battery_get_level(void) { return 100; }
+int session_is_locked(const Session *s) { return 0; }
+int session_paste_progress(const Session *s) { return -1; }
+
+void vterm_state_get_cursorpos(const VTermState *state, VTermPos *cursorpos) {
+  cursorpos->row = 0;
+  cursorpos->col = 0;
+}
@@ -0,0 +1,187 @@
+// scrollback まわりのホスト側マイクロベンチ（make bench）。
+// SDL と libvterm はヘッダだけ使う。scrollback.c / search.c をそのままリンクして、
+// 実機ではなくビルドマシンで比べるための数字を出す
+#include "scrollback.h"
+#include "term.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  int (*run)(void);
+} Bench;
+
+static int bench_pack(void);
+static int bench_cold(void);
+static int bench_spill(void);
+static int bench_history(Session *s, int lines, double *push_ns, double *read_ns);
+static void bench_session(Session *s, App *app, int max_lines);
+static void bench_synth_line(ScrollbackCell *dst, int n);
+static ScrollbackCell bench_pack_cell(Session *s, const VTermScreenCell *cell);
+static void bench_line(VTermScreenCell *line);
+
+static const Bench benches[] = {
+  { "pack", bench_pack },
+  { "cold", bench_cold },
+  { "spill", bench_spill },
+};
+
+// 引数なしなら全部、あれば名前の一致したものだけ
+int main(int argc, char **argv) {
+  int rc = 0;
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    int want = argc < 2;
+    for (int a = 1; a < argc; a++) want |= strcmp(argv[a], benches[i].name) == 0;
+    if (want && benches[i].run() != 0) {
+      fprintf(stderr, "bench %s: FAILED\n", benches[i].name);
+      rc = 1;
+    }
+  }
+  return rc;
+}
+
+// sb_line_pack（1行まとめて）と、以前の 1 セルずつの詰め方を同じ行で比べる
+static int bench_pack(void) {
+  enum { ITERS = 1000000 };
+  static Session s;
+  VTermScreenCell line[TERM_COLS];
+  ScrollbackCell a[TERM_COLS], b[TERM_COLS];
+
+  bench_line(line);
+  sb_line_pack(&s, a, line, TERM_COLS);
+  for (int c = 0; c < TERM_COLS; c++) b[c] = bench_pack_cell(&s, &line[c]);
+  if (memcmp(a, b, sizeof(a)) != 0) return 1;
+
+  uint64_t t0 = util_now_ns();
+  for (int i = 0; i < ITERS; i++) {
+    sb_line_pack(&s, a, line, TERM_COLS);
+    __asm__ volatile("" : : "r"(a) : "memory");
+  }
+  uint64_t t1 = util_now_ns();
+  for (int i = 0; i < ITERS; i++) {
+    for (int c = 0; c < TERM_COLS; c++) b[c] = bench_pack_cell(&s, &line[c]);
+    __asm__ volatile("" : : "r"(b) : "memory");
+  }
+  uint64_t t2 = util_now_ns();
+
+  printf("pack: %d cols, line pack %.0f ns/line, per-cell %.0f ns/line\n",
+         TERM_COLS, (double)(t1 - t0) / ITERS, (double)(t2 - t1) / ITERS);
+  return 0;
+}
+
+// 既定の scrollback_lines=100000 に 150000 行を流し、残った行を全部読み戻して突き合わせる
+static int bench_cold(void) {
+  static Session s;
+  static App app;
+  bench_session(&s, &app, 100000);
+
+  double push_ns, read_ns;
+  int bad = bench_history(&s, 150000, &push_ns, &read_ns);
+  printf("cold: kept %d lines, hot %d, cold %d blocks %zu KiB, push %.0f ns/line, read %.0f ns/line, mismatches %d\n",
+         s.sb_count, s.sb_hot_count, s.sb_cold_count, s.sb_cold_bytes / 1024, push_ns, read_ns, bad);
+  sb_store_free(&s);
+  return bad != 0;
+}
+
+// scrollback_lines=20000 + scrollback_spill=1 で 150000 行。上限を超えた分はスピルファイルから読み戻す
+static int bench_spill(void) {
+  static Session s;
+  static App app;
+  const char *tmp = getenv("TMPDIR");
+  snprintf(app.cfg.config_dir, sizeof(app.cfg.config_dir), "%s", tmp && tmp[0] ? tmp : "/tmp");
+  app.cfg.scrollback_spill = 1;
+  bench_session(&s, &app, 20000);
+
+  double push_ns, read_ns;
+  int bad = bench_history(&s, 150000, &push_ns, &read_ns);
+  printf("spill: kept %d lines, cold %d blocks, spilled %d blocks %llu KiB, push %.0f ns/line, read %.0f ns/line, mismatches %d\n",
+         s.sb_count, s.sb_cold_count, s.sb_spill_count, (unsigned long long)(s.sb_spill_size / 1024),
+         push_ns, read_ns, bad);
+  int ok = s.sb_spill_count > 0 && bad == 0;
+  sb_store_free(&s);
+  return !ok;
+}
+
+// lines 行を push し、残っている行（最古から）を全部 sb_line で読み戻して作り直した行と比べる
+static int bench_history(Session *s, int lines, double *push_ns, double *read_ns) {
+  uint64_t t0 = util_now_ns();
+  for (int n = 0; n < lines; n++) {
+    ScrollbackCell *dst = sb_store_push(s, 0);
+    if (dst) bench_synth_line(dst, n);
+  }
+  uint64_t t1 = util_now_ns();
+
+  int bad = 0, first = lines - s->sb_count;
+  ScrollbackCell want[TERM_COLS];
+  for (int i = 0; i < s->sb_count; i++) {
+    const ScrollbackCell *line = sb_line(s, i);
+    bench_synth_line(want, first + i);
+    if (!line || memcmp(line, want, sizeof(want)) != 0) bad++;
+  }
+  uint64_t t2 = util_now_ns();
+
+  *push_ns = (double)(t1 - t0) / lines;
+  *read_ns = s->sb_count > 0 ? (double)(t2 - t1) / s->sb_count : 0;
+  return bad;
+}
+
+static void bench_session(Session *s, App *app, int max_lines) {
+  memset(s, 0, sizeof(*s));
+  s->app = app;
+  s->sb_spill_fd = -1;
+  sb_store_init(s, max_lines);
+}
+
+// 行番号から決まる合成ログ行。5 行に 1 行は先頭の語を 256 色、40 行に 1 行は太字にする
+static void bench_synth_line(ScrollbackCell *dst, int n) {
+  char text[TERM_COLS + 1];
+  snprintf(text, sizeof(text), "[%6d] step %d: cc -c src/mod%03d.c -o src/mod%03d.o", n, n % 7, n % 211, n % 211);
+
+  ScrollbackCell plain = sb_cell_blank() & ~(ScrollbackCell)0x1FFFFF;
+  ScrollbackCell head = plain;
+  if (n % 5 == 0) {
+    head = (head & ~((ScrollbackCell)0xFFF << SB_CELL_FG_SHIFT))
+         | ((ScrollbackCell)(SB_COLOR_PALETTE_BASE + 2) << SB_CELL_FG_SHIFT);
+  }
+  if (n % 40 == 0) head |= (ScrollbackCell)CELL_ATTR_BOLD << SB_CELL_ATTR_SHIFT;
+
+  size_t len = strlen(text);
+  for (int c = 0; c < TERM_COLS; c++) {
+    uint32_t cp = (size_t)c < len ? (unsigned char)text[c] : ' ';
+    dst[c] = (ScrollbackCell)cp | (c < 8 ? head : plain);
+  }
+}
+
+// 一行パック以前の詰め方（セルごとに属性と色を引き直す）
+static ScrollbackCell bench_pack_cell(Session *s, const VTermScreenCell *cell) {
+  uint32_t cp = 0;
+  int width = cell->width;
+  if (width < 0 || width > 2) width = 1;
+  if (width > 0) {
+    cp = cell->chars[0] ? cell->chars[0] : ' ';
+    if (cp > 0x1FFFFF) cp = 0xFFFD;
+  }
+  return (ScrollbackCell)cp | ((ScrollbackCell)width << SB_CELL_WIDTH_SHIFT)
+    | ((ScrollbackCell)term_cell_attrs(cell) << SB_CELL_ATTR_SHIFT)
+    | ((ScrollbackCell)sb_color_id(&s->sb_colors, cell->fg) << SB_CELL_FG_SHIFT)
+    | ((ScrollbackCell)sb_color_id(&s->sb_colors, cell->bg) << SB_CELL_BG_SHIFT);
+}
+
+// 既定色の文字の後ろに 24bit 色の太字が続く行（ls --color やコンパイラの出力のような混在）
+static void bench_line(VTermScreenCell *line) {
+  memset(line, 0, sizeof(VTermScreenCell) * TERM_COLS);
+  for (int c = 0; c < TERM_COLS; c++) {
+    line[c].chars[0] = 'a' + c % 26;
+    line[c].width = 1;
+    line[c].fg.type = VTERM_COLOR_RGB | VTERM_COLOR_DEFAULT_FG;
+    line[c].bg.type = VTERM_COLOR_RGB | VTERM_COLOR_DEFAULT_BG;
+    if (c > 40) {
+      line[c].fg.type = VTERM_COLOR_RGB;
+      line[c].fg.rgb.red = 200;
+      line[c].attrs.bold = 1;
+    }
+  }
+}
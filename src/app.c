@@ -2,14 +2,22 @@
 
 #include "backlight.h"
 #include "config.h"
+#include "evloop.h"
 #include "input.h"
 #include "render.h"
 #include "session.h"
+#include "stats.h"
+#include "strcache.h"
 #include "text.h"
 #include "ui.h"
+#include "util.h"
 
 #include <unistd.h>
 
+static int app_next_timeout_ms(App *app);
+static int app_frame_wait_ms(App *app, Uint32 now);
+static void app_update_fast_forward(App *app, Uint32 now);
+
 static const char *const k_required_nerd_icons[] = {
   "󰘴", "󰘵", "󰘳", "󰘶", "", "", "󰘌", "󰘠", "⎋", "␣", "⌫", "󰩭", "󰄬", "", "¹", NULL
 };
@@ -19,12 +27,15 @@ int app_init(App *app) {
     printf("Failed to load or create config.\n");
   }
   
-  app->render.def_fg = (SDL_Color){240,240,240,255};
-  app->render.def_bg = (SDL_Color){0,0,0,255};
-  app->need_redraw = 1;
+  app->render.def_fg = app->cfg.theme_fg;
+  app->render.def_bg = app->cfg.theme_bg;
+  app->need_redraw = REDRAW_ALL;
 
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0) return -1;
 
+  // セッションより先に用意する（session_create が PTY を登録する）
+  (void)evloop_init(app);
+
   app->win = SDL_CreateWindow("GKDTerm", 0, 0, SCREEN_W, SCREEN_H, SDL_WINDOW_FULLSCREEN);
   if (!app->win) return -1;
 
@@ -51,25 +62,109 @@ int app_init(App *app) {
 
 void app_run(App *app) {
   while (!app->quit) {
+    sessions_lock_all(app);
     input_handle_input(app);
     ui_update_timers_and_io(app);
+    sessions_unlock_all(app);
+
+    // この周の入力・貼り付けをまとめて書く
+    sessions_flush_output(app);
+
+    Uint32 now = SDL_GetTicks();
+    app_update_fast_forward(app, now);
+
+    // 間隔が空くまでの出力は次のフレームにまとめる
+    int frame_wait = app->need_redraw ? app_frame_wait_ms(app, now) : -1;
 
     int did_render = 0;
-    if (app->need_redraw) {
+    if (app->need_redraw && frame_wait == 0) {
+      int what = app->need_redraw;
       app->need_redraw = 0;
       did_render = 1;
-      render_frame(app);
+
+      // 描画中は表示中セッションの解析だけ待たせる（裏のセッションは進む）
+      Session *s = SESSION(app);
+      session_lock(s);
+      uint64_t t0 = util_now_ns();
+      render_frame(app, what);
+      Uint32 us = (Uint32)((util_now_ns() - t0) / 1000);
+      session_unlock(s);
+
+      app->stats.frame_us += us;
+      if (us > app->stats.frame_us_max) app->stats.frame_us_max = us;
+
+      app->pacing.last_frame = now;
+      if (app->pacing.fast_forward) app->stats.ff_frames++;
+    }
+    stats_tick(app);
+
+    if (app->ev.epfd >= 0) {
+      // PTY 出力・ボタン・タイマ・他スレッドからの通知のどれかが来るまで眠る
+      evloop_set_tick(app, ui_needs_tick(app));
+      int timeout = app_next_timeout_ms(app);
+      if (frame_wait > 0 && (timeout < 0 || frame_wait < timeout)) timeout = frame_wait;
+      evloop_wait(app, timeout);
+    } else {
+      if (app->backlight.screen_blank) SDL_Delay(50);
+      else SDL_Delay(did_render ? 1 : 12);
     }
-    
-    if (app->backlight.screen_blank) SDL_Delay(50); 
-    else SDL_Delay(did_render ? 1 : 12);
   }
 }
 
+// 次のフレームを描けるまでの残り ms。
+// 入力による描画は fps 上限だけ、出力だけの描画は早送り中ならさらに間引く
+static int app_frame_wait_ms(App *app, Uint32 now) {
+  Uint32 interval = 0;
+  if (app->cfg.fps_cap > 0) interval = 1000 / (Uint32)app->cfg.fps_cap;
+  if (app->pacing.fast_forward && !(app->need_redraw & REDRAW_ALL)) interval = FAST_FORWARD_FRAME_MS;
+
+  Uint32 elapsed = now - app->pacing.last_frame;
+  return (elapsed >= interval) ? 0 : (int)(interval - elapsed);
+}
+
+// 表示中セッションの出力量を FAST_FORWARD_WINDOW_MS ごとに測り、早送りを切り替える
+static void app_update_fast_forward(App *app, Uint32 now) {
+  FramePacing *fp = &app->pacing;
+  Session *s = SESSION(app);
+  uint64_t rx = atomic_load(&s->rx_total);
+
+  if (fp->window_sess != app->active_sess) {
+    fp->window_sess = app->active_sess;
+    fp->window_start = now;
+    fp->window_rx = rx;
+    fp->fast_forward = 0;
+    return;
+  }
+
+  Uint32 elapsed = now - fp->window_start;
+  if (elapsed < FAST_FORWARD_WINDOW_MS) return;
+
+  fp->out_kbps = (Uint32)((rx - fp->window_rx) * 1000 / 1024 / elapsed);
+  fp->window_start = now;
+  fp->window_rx = rx;
+
+  int ff = app->cfg.ff_kbps > 0 && fp->out_kbps > (Uint32)app->cfg.ff_kbps;
+  if (ff != fp->fast_forward) {
+    fp->fast_forward = ff;
+    if (!ff) app->need_redraw |= REDRAW_OUTPUT;   // 早送りを抜けたら最新の画面を出す
+  }
+}
+
+// 時間で起きる必要のある処理（キーリピート・長押し待ち）までの残り時間。無ければ -1
+static int app_next_timeout_ms(App *app) {
+  int t = input_next_timeout_ms(app);
+  int u = ui_next_timeout_ms(app);
+  if (t < 0 || (u >= 0 && u < t)) t = u;
+  return t;
+}
+
 void app_shutdown(App *app) {
   for (int i = 0; i < MAX_SESSIONS; i++) session_destroy(app, i);
+  evloop_shutdown(app);
 
+  render_shutdown(app);
   glyph_cache_clear(app);
+  strcache_clear(app);
   if (app->font) { TTF_CloseFont(app->font); app->font = NULL; }
   TTF_Quit();
 
@@ -85,12 +180,14 @@ void app_enter_blank(App *app) {
   app->backlight.screen_blank = 1;
   app->backlight.wake_armed = 0;
   (void)backlight_off(app);
-  app->need_redraw = 1;
+  evloop_set_tick(app, 0);   // 消灯中はボタンで起きるだけ
+  app->need_redraw |= REDRAW_ALL;
 }
 
 void app_exit_blank(App *app) {
   (void)backlight_restore(app);
   app->backlight.screen_blank = 0;
   app->backlight.wake_armed = 0;
-  app->need_redraw = 1;
+  evloop_set_tick(app, ui_needs_tick(app));
+  app->need_redraw |= REDRAW_ALL;
 }
@@ -2,6 +2,8 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -20,8 +22,17 @@
 
 #define KEY_ROWS 4
 #define KEY_COLS 10
-
-#define SCROLLBACK_LINES 2000
+#define KEY_LAYERS 3
+
+#define SB_GROW_LINES 256   // scrollback はこの行数ずつ確保を伸ばす
+#define SB_BLOCK_LINES 256  // cold に移すときの圧縮単位
+#define SB_HOT_LINES_MAX 1024   // 非圧縮で持つ直近の行数（SB_BLOCK_LINES の倍数）
+#define SB_DECODE_CACHE 4   // 展開済みで持っておく cold ブロック数
+#define SB_BLOOM_BITS_PER_GRAM 8   // trigram の異なり数 1 つあたりのビット数（k=3 で偽陽性 3% 前後）
+#define SB_BLOOM_MIN_BYTES 64
+#define SB_BLOOM_MAX_BYTES 8192
+#define SEARCH_QUERY_MAX 48
+#define OSC_BUF_MAX 1024
 #define MAX_SESSIONS 5
 
 #define STATUS_Y 0
@@ -34,6 +45,17 @@
 #define SCREENSHOT_DELAY_MS 120
 
 #define CURSOR_BLINK_HALF_MS 250
+
+// need_redraw のビット。CURSOR/STATUS だけなら端末領域は描画キャッシュを貼り直すだけ
+#define REDRAW_ALL    0x01
+#define REDRAW_STATUS 0x02   // 時計・電池残量
+#define REDRAW_CURSOR 0x04   // カーソルの点滅
+#define REDRAW_OUTPUT 0x08   // 表示中セッションの出力（fps 上限・早送りの対象）
+
+// 描画間隔の制御
+#define FAST_FORWARD_WINDOW_MS 250   // 出力量を測る窓
+#define FAST_FORWARD_FRAME_MS 250    // 早送り中の出力だけによる描画の間隔
+#define TEXT_BLINK_HALF_MS 500     // SGR 5 (blink) の点滅周期
 #define BATT_UPDATE_MS 5000
 
 #define MENU_ITEMS (MAX_SESSIONS + 1)
@@ -53,6 +75,7 @@
 #define STATUSBAR_MOD_X 150
 #define STATUSBAR_CURSOR_X 220
 #define STATUSBAR_REGION_X 330
+#define STATUSBAR_SEARCH_CHARS 12   // 検索語はこの文字数だけ末尾を表示
 #define STATUSBAR_RIGHT_MARGIN 10
 #define STATUSBAR_TIME_BATT_GAP_STR "   "
 
@@ -87,6 +110,12 @@
 // Config constants
 #define CONFIG_FONT_SIZE_MIN 6
 #define CONFIG_FONT_SIZE_MAX 96
+#define CONFIG_GLYPH_CACHE_KB_DEFAULT 16384
+#define CONFIG_FPS_CAP_DEFAULT 60
+#define CONFIG_FPS_CAP_MAX 240
+#define CONFIG_FF_KBPS_DEFAULT 1024
+#define CONFIG_SCROLLBACK_LINES_DEFAULT 100000
+#define CONFIG_SCROLLBACK_LINES_MAX 1000000
 
 typedef enum {
   BTN_B = 0,
@@ -112,12 +141,130 @@ typedef enum {
   MOD_LOCKED
 } ModState;
 
+// セル属性（ScrollbackCell.attrs / render_draw_cell_rgb）
+#define CELL_ATTR_BOLD       0x01
+#define CELL_ATTR_ITALIC     0x02
+#define CELL_ATTR_UNDERLINE  0x04
+#define CELL_ATTR_DUNDERLINE 0x08   // 二重下線
+#define CELL_ATTR_STRIKE     0x10
+#define CELL_ATTR_DIM        0x20
+#define CELL_ATTR_BLINK      0x40
+#define CELL_ATTR_REVERSE    0x80
+
+// scrollback のセルは 8 バイトに詰める（読み書きは sb_cell_* / sb_line_pack 経由）
+//   bit  0-20 コードポイント / 21-22 幅(0/1/2) / 23-30 CELL_ATTR_* / 31-42 前景色ID / 43-54 背景色ID
+typedef uint64_t ScrollbackCell;
+
+#define SB_CELL_WIDTH_SHIFT 21
+#define SB_CELL_ATTR_SHIFT  23
+#define SB_CELL_FG_SHIFT    31
+#define SB_CELL_BG_SHIFT    43
+
+// 表示行の内容ID（描画キャッシュの blit 判定用）。scrollback の行はこのビットを立てた通し番号
+#define SB_LINE_ID_SCROLLBACK (1ull << 63)
+
+// 色ID: 既定色 → 256色パレット → セッションごとに重複排除した RGB
+#define SB_COLOR_DEFAULT_FG 0
+#define SB_COLOR_DEFAULT_BG 1
+#define SB_COLOR_PALETTE_BASE 2       // 2..257
+#define SB_COLOR_RGB_BASE 258
+#define SB_COLOR_IDS 4096             // 12bit。溢れた RGB は最寄りの256色に丸める
+#define SB_COLOR_HASH_SIZE 8192       // 2の冪
+#define SB_COLOR_SWEEP_MISSES 64      // 丸めがこれだけ続いたら使われなくなった ID を回収する
+
+typedef struct {
+  uint32_t rgb[SB_COLOR_IDS];         // SB_COLOR_RGB_BASE 以降だけ使う（0xRRGGBB）
+  uint16_t hash[SB_COLOR_HASH_SIZE];  // 0 = 空き、それ以外は色ID
+  int count;                          // 払い出した ID の数（回収済みも含む）
+  uint16_t free_ids[SB_COLOR_IDS];    // 回収して空いている ID
+  int free_count;
+  int misses;                         // 前回の回収から丸めた回数
+  uint32_t fallbacks;                 // 丸めた回数（stats_log が回収してゼロに戻す）
+} SbColorTable;
+
+// cold ブロック: SB_BLOCK_LINES 行分のセルをコードポイント面と残り(幅・属性・色)面に分けて RLE
+typedef struct {
+  uint8_t *data;                         // スピル済みなら NULL
+  uint32_t size;
+  uint64_t seq;                          // 展開キャッシュのキー（セッション内で単調増加）
+  uint64_t off;                          // スピルファイル内の位置（data == NULL の時）
+  uint8_t cont[SB_BLOCK_LINES / 8];      // 行ごとの継続フラグ
+  uint8_t *bloom;                        // 検索用の trigram 要約（スピル済みならファイル上の data の直後）
+  uint32_t bloom_bytes;                  // 要約の大きさ（2の冪。0 なら要約なし）
+  uint16_t *rgb_ids;                     // ブロック内で使っている RGB の色ID（色IDの回収用。無ければ NULL）
+  int rgb_count;
+} SbColdBlock;
+
+// 検索モード（search.c）。一致は sb_region_line_hl_range で強調する
+typedef struct {
+  int active;
+  char query[SEARCH_QUERY_MAX + 1];      // ASCII（ソフトウェアキーボードから）
+  int len;
+  int match_line;                        // 仮想行。-1 = 一致なし
+  int match_col, match_end_col;
+  int failed;                            // 直前の検索で見つからなかった
+  unsigned seq;                          // 状態が変わるたびに進む（ステータスバーの描き直し判定用）
+} SbSearch;
+
 typedef struct {
-  uint32_t ch;
+  uint64_t seq;                          // 0 = 空き
+  unsigned last_used;
+  ScrollbackCell *cells;                 // SB_BLOCK_LINES × TERM_COLS
+} SbDecodedBlock;
+
+static inline uint32_t sb_cell_cp(ScrollbackCell c)    { return (uint32_t)(c & 0x1FFFFF); }
+static inline int sb_cell_width(ScrollbackCell c)      { return (int)((c >> SB_CELL_WIDTH_SHIFT) & 0x3); }
+static inline uint8_t sb_cell_attrs(ScrollbackCell c)  { return (uint8_t)(c >> SB_CELL_ATTR_SHIFT); }
+static inline unsigned sb_cell_fg(ScrollbackCell c)    { return (unsigned)((c >> SB_CELL_FG_SHIFT) & 0xFFF); }
+static inline unsigned sb_cell_bg(ScrollbackCell c)    { return (unsigned)((c >> SB_CELL_BG_SHIFT) & 0xFFF); }
+
+// 画面のセルのキャッシュ（vterm_screen_get_cell の代わりに読む。色は解決済み・反転は未適用）
+typedef struct {
+  uint32_t ch;       // 幅0のセルは 0
   SDL_Color fg, bg;
   uint8_t width;     // 0/1/2
-  uint8_t reverse;
-} ScrollbackCell;
+  uint8_t attrs;     // CELL_ATTR_*
+} ScreenCell;
+
+// PTY の読み出しスレッド → 解析スレッド の単一生産者・単一消費者リング
+#define PTY_RING_SIZE (256 * 1024)  // 2の冪
+#define PTY_READ_MIN 4096
+#define PTY_READ_MAX (64 * 1024)     // 読み切れないほど出力が続く間は倍々に広げる
+#define PTY_PARSE_SLICE (16 * 1024)  // 1回の vterm_input_write に渡す上限
+#define PTY_PARSE_BUDGET_NS 4000000ull   // 1回のロック保持で解析に使う時間の上限
+
+// 画面を持つ層（Makefile の VTERM_BACKEND で選ぶ）
+#ifdef GKD_VTERM_STATE_BACKEND
+#define VTERM_BACKEND_NAME "state"
+#else
+#define VTERM_BACKEND_NAME "screen"
+#endif
+
+typedef struct {
+  uint8_t buf[PTY_RING_SIZE];
+  _Atomic size_t head;   // 読み出しスレッドだけが進める
+  _Atomic size_t tail;   // 解析スレッドだけが進める
+} PtyRing;
+
+// PTY への書き込み待ち（UI スレッドが積み、書ける分だけ少しずつ書く）
+#define PTY_OUT_MAX (1024 * 1024)   // これを超える分は捨てる
+#define PTY_WRITE_CHUNK 4096        // 1周で write する上限（大きな貼り付けは小分けに流れる）
+
+typedef struct {
+  char *buf;
+  size_t off;                   // 書き込み済み
+  size_t len;                   // 積まれた末尾
+  size_t cap;
+} PtyOutQueue;
+
+// 貼り付け中の本文（キューが PASTE_QUEUE_LOW を下回るたびに続きを積む）
+#define PASTE_QUEUE_LOW (PTY_WRITE_CHUNK * 2)
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t off;
+} PasteStream;
 
 typedef struct {
   struct App *app;
@@ -127,20 +274,91 @@ typedef struct {
   int pty_fd;
   pid_t pid;
 
+  // vterm・scrollback・dirty_rows は lock で守る（解析スレッドと UI スレッドで共有）
+  pthread_mutex_t lock;
+  pthread_t reader_thread;
+  pthread_t parser_thread;
+  int threads_started;
+  int stop_fd;                  // eventfd: 読み出しスレッドの poll を止める
+  _Atomic int stop;
+  _Atomic int output_pending;   // 解析済みの出力がある（UI スレッドが描画要否の判定に使う）
+  _Atomic int ui_waiting;       // UI スレッドが lock を待っている
+  _Atomic uint64_t rx_total;    // PTY から読んだ累計バイト数（早送りの判定用）
+  PtyRing ring;
+  pthread_mutex_t ring_mtx;     // 空・満杯で眠る時だけ使う
+  pthread_cond_t ring_data_cv;
+  pthread_cond_t ring_space_cv;
+  pthread_mutex_t out_mtx;      // out は解析スレッド（libvterm の応答）からも積まれる
+  PtyOutQueue out;
+  PasteStream paste;            // UI スレッドだけが触る
+  size_t read_size;             // 読み出しスレッドの現在の read() サイズ
+
+  // 計測（スレッドが加算し、stats_tick が回収してゼロに戻す）
+  _Atomic uint64_t st_read_bytes;
+  _Atomic uint32_t st_reads;
+  _Atomic uint32_t st_flushes;
+  _Atomic uint64_t st_parse_ns;
+  _Atomic uint32_t st_yields;   // 予算切れ・UI 待ちで解析を中断した回数
+  _Atomic uint64_t st_push_ns;  // scrollback への押し出し（parse の内数）
+  _Atomic uint32_t st_pushes;
+
   VTerm *vt;
-  VTermScreen *vts;
+  VTermScreen *vts;             // VTERM_BACKEND=state では使わない（NULL）
   VTermState *vts_state;
 
-  ScrollbackCell sb_buf[SCROLLBACK_LINES][TERM_COLS];
-  uint8_t sb_cont[SCROLLBACK_LINES];
-  int sb_head;
-  int sb_count;
+#ifdef GKD_VTERM_STATE_BACKEND
+  // VTermState のコールバックが直接書く画面（grid.c）
+  ScrollbackCell grid[2][TERM_ROWS][TERM_COLS];  // 0: 通常画面 1: 代替画面
+  uint8_t grid_cont[2][TERM_ROWS];               // 前の行から折り返した行
+  int grid_alt;
+  ScrollbackCell grid_pen;                       // 現在のペン（属性と色IDのビットだけ）
+#endif
+
+  // scrollback（scrollback.c の sb_store_* / sb_line 経由で触る）
+  // 直近は非圧縮のリング（hot）、溢れた古い行は SB_BLOCK_LINES 行ずつ圧縮して cold へ
+  ScrollbackCell *sb_buf;   // hot: sb_cap 行 × TERM_COLS。session_create で確保し、溢れたら sb_hot_max まで伸ばす
+  SbColorTable sb_colors;   // セルの RGB 色ID（解析スレッドが lock 下で登録）
+  uint8_t *sb_cont;
+  int sb_cap;               // 確保済みの行数（リングの周期）
+  int sb_hot_max;           // hot の上限行数
+  int sb_max;               // 全体の行数の上限（cfg.scrollback_lines）
+  int sb_head;              // hot の次に書く行
+  int sb_hot_count;
+  int sb_count;             // スピル + cold + hot の行数
+  uint64_t sb_dropped;      // これまでに捨てた行数（scrollback の行IDの起点）
+  SbColdBlock *sb_cold;     // 古い順
+  int sb_cold_count;
+  int sb_cold_cap;
+  uint64_t sb_cold_seq;
+  size_t sb_cold_bytes;
+  SbColdBlock *sb_spill;    // スピルファイルに移したブロックの索引（古い順）
+  int sb_spill_count;
+  int sb_spill_cap;
+  int sb_spill_fd;          // -1 = 未作成
+  uint64_t sb_spill_size;
+  SbDecodedBlock sb_decoded[SB_DECODE_CACHE];
+  unsigned sb_decode_clock;
+  unsigned repaint_seq; // 描き終えた行の見た目が変わった時に進む（パレット変更など）
   int view_offset_lines;
 
+  // libvterm の damage で汚れた行（vterm の行番号）
+  uint8_t dirty_rows[TERM_ROWS];     // 描画側が描き直したら落とす
+  ScreenCell screen_rows[TERM_ROWS][TERM_COLS];
+  uint8_t screen_stale[TERM_ROWS];   // term_screen_row が取り直したら落とす
+  uint64_t screen_row_id[TERM_ROWS]; // 行の内容ID（moverect で行と一緒に動く）
+  uint64_t screen_id_next;
+
   int region_mode;
   int selecting;
   int reg_line, reg_col;
   int sel_line, sel_col;
+
+  SbSearch search;
+
+  // 256色パレットの RGB（描画はここを引くだけ。OSC 4/104 とテーマ適用の時だけ作り直す）
+  SDL_Color palette[256];
+  char osc_buf[OSC_BUF_MAX];    // 分割されて届く OSC の文字列を貯める
+  int osc_len;
 } Session;
 
 typedef struct {
@@ -148,18 +366,100 @@ typedef struct {
   const char *send;  // send_key()用
 } KeyDefinition;
 
+// グリフはフォントスタイル（太字・斜体）ごとに別エントリとしてキャッシュする
+#define GLYPH_STYLE_MASK (CELL_ATTR_BOLD | CELL_ATTR_ITALIC)
+
 typedef struct {
   uint32_t cp;
-  SDL_Texture *tex;
-  int w, h;
+  uint16_t x, y;     // アトラス内の位置
+  uint16_t w, h;
+  uint8_t page;
+  uint8_t style;     // CELL_ATTR_BOLD / CELL_ATTR_ITALIC
   uint8_t used;
 } GlyphCacheEntry;
 
 #define GLYPH_CACHE_SIZE 4096
+#define GLYPH_CACHE_MAX_LOAD (GLYPH_CACHE_SIZE * 3 / 4)   // これを超えたら追い出す
+
+// グリフアトラス（大きめのテクスチャに棚詰めする）
+// ページ数の上限は cfg.glyph_cache_kb（テクスチャメモリの予算）で決まる
+#define GLYPH_ATLAS_PAGES 8
+#define GLYPH_ATLAS_SIZE 1024
+#define GLYPH_ATLAS_PAGE_BYTES (GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE * 4)
+#define GLYPH_ATLAS_MAX_SHELVES 64
+#define GLYPH_ATLAS_PADDING 1
+
+typedef struct {
+  int y, h;
+  int x;             // 次の空き位置
+} GlyphAtlasShelf;
+
+typedef struct {
+  SDL_Texture *tex;
+  int shelf_count;
+  GlyphAtlasShelf shelves[GLYPH_ATLAS_MAX_SHELVES];
+  int next_y;
+  uint32_t last_used;   // ページ単位の LRU
+} GlyphAtlasPage;
+
+// 1フレーム分のセル描画をページごとに1回の SDL_RenderGeometry にまとめる
+#define GLYPH_BATCH_QUADS (TERM_ROWS * TERM_COLS)
+
+typedef struct {
+  SDL_Vertex verts[GLYPH_ATLAS_PAGES][GLYPH_BATCH_QUADS * 4];
+  int quads[GLYPH_ATLAS_PAGES];
+  int indices[GLYPH_BATCH_QUADS * 6];
+  int indices_ready;
+} GlyphBatch;
+
+// UI 文字列テクスチャのキャッシュ（ステータスバー・メニュー・キーボードのラベル）
+#define STRCACHE_ENTRIES 128
+#define STRCACHE_TEXT_MAX 128
+#define STRCACHE_MEM_CAP (2 * 1024 * 1024)
+
+typedef struct {
+  char text[STRCACHE_TEXT_MAX];
+  uint32_t hash;
+  SDL_Color fg;
+  SDL_Texture *tex;    // NULL なら幅だけのエントリ
+  int w, h;
+  uint32_t last_used;
+  uint8_t used;
+} StrCacheEntry;
+
+typedef struct {
+  StrCacheEntry entries[STRCACHE_ENTRIES];
+  uint32_t clock;
+  size_t bytes;        // テクスチャの概算使用量 (w * h * 4)
+  Uint32 hits;
+  Uint32 misses;
+  Uint32 evictions;
+} StrCache;
+
+// 背景色の矩形（同色の連続セルをまとめたもの）
+#define BG_SPAN_MAX (TERM_ROWS * TERM_COLS)
+
+typedef struct {
+  SDL_Rect rects[BG_SPAN_MAX];
+  SDL_Color colors[BG_SPAN_MAX];
+  int count;
+  SDL_Rect scratch[BG_SPAN_MAX];   // flush 時の同色集約用
+} BgSpanBatch;
 
 typedef struct {
   char font_path[512];  // 空文字列なら未指定扱い
   int  font_size;       // 例: 18
+  int  stats_log;       // 1 なら描画統計を定期的に stderr へ出す
+  int  glyph_cache_kb;  // グリフアトラスのテクスチャメモリ予算
+  int  fps_cap;         // 描画の上限 fps（0 で無制限）
+  int  ff_kbps;         // 出力がこれ (KiB/s) を超えたら早送り（0 で無効）
+  int  scrollback_lines;   // セッションごとに RAM に持つ scrollback 行数の上限
+  int  scrollback_spill;   // 1 = 上限を超えた行をスピルファイルに逃がす
+  char scrollback_spill_dir[512];   // 空なら config_dir
+  char config_dir[512];
+  SDL_Color theme_fg, theme_bg;   // 既定の前景・背景色（foreground / background）
+  SDL_Color theme[16];            // ANSI 16色（color0..color15）
+  uint16_t theme_set;             // theme のうち設定されたもの（bit i = color i）
 } AppConfig;
 
 typedef struct {
@@ -206,6 +506,8 @@ typedef struct {
 
 typedef struct {
   int prev_cursor_on;
+  int prev_text_blink_on;
+  int prev_paste_pct;
   int prev_minute;
   Uint32 last_batt_tick;
   int cached_batt;
@@ -223,12 +525,125 @@ typedef struct {
   Uint32 wake_since;
 } BacklightState;
 
+// UI レイヤの描き直し判定用（前回描画時の状態と比べる）
+typedef struct {
+  int kbd_layer;
+  ModState mod_ctrl, mod_alt, mod_meta, mod_shift;
+  int cursor_mode;
+  int region_mode;
+  int selecting;
+  int batt;
+  int hour, minute;
+  int paste_pct;      // 貼り付けの進み具合（-1 なら無し）
+  int search_active;
+  unsigned search_seq;
+} StatusLayerSig;
+
+typedef struct {
+  int menu_sel;
+  int active_sess;
+  uint8_t used[MAX_SESSIONS];
+  uint8_t locked[MAX_SESSIONS];
+} MenuLayerSig;
+
 typedef struct {
   SDL_Color def_fg;
   SDL_Color def_bg;
   GlyphCacheEntry glyph_cache[GLYPH_CACHE_SIZE];
+  int glyph_count;
+  uint32_t glyph_clock;
+  Uint32 glyph_hits;
+  Uint32 glyph_misses;
+  Uint32 glyph_evictions;     // 追い出したグリフ数
+  Uint32 glyph_page_evictions;
+  GlyphAtlasPage atlas[GLYPH_ATLAS_PAGES];
+  int atlas_pages;
+  GlyphBatch batch;
+  BgSpanBatch bg_spans;
+  BgSpanBatch deco_spans;       // 下線・取り消し線（グリフの後に描く）
+  StrCache strcache;
+
+  // 端末領域の描画キャッシュ（汚れた行だけ描き直す）
+  SDL_Texture *term_tex;
+  SDL_Texture *term_tex_back;   // スクロールを blit する先（描いたら term_tex と入れ替える）
+  int targets_failed;           // レンダーターゲット非対応なら毎回直接描画
+  int term_valid;
+  int term_drawn_sess;
+  unsigned term_drawn_repaint_seq;
+  uint64_t term_drawn_id[TERM_ROWS];   // 各行に描いてある内容ID（0 は未描画）
+  int term_drawn_hl[TERM_ROWS][2];
+  uint8_t term_row_blink[TERM_ROWS];   // 点滅属性のセルを含む行
+  int blink_on;                 // 点滅属性のセルを表示する位相か
+  int term_drawn_blink_on;
+
+  // UI レイヤ（ステータスバー・キーボード・セッションメニュー）
+  SDL_Texture *status_tex;
+  int status_dirty;
+  StatusLayerSig status_sig;
+
+  SDL_Texture *kbd_tex[KEY_LAYERS];   // 選択なしの状態。選択キーは毎フレーム上に重ねる
+  int kbd_dirty[KEY_LAYERS];
+
+  SDL_Texture *menu_tex;
+  int menu_dirty;
+  MenuLayerSig menu_sig;
+
+  // 画面全体の合成結果。部分フレームはここのカーソルのセルとステータスバーだけ直して出す
+  SDL_Texture *frame_tex;
+  int frame_valid;
+  int frame_cursor_on;          // frame_tex にカーソルを描いてあるか
+  SDL_Rect frame_cursor;
 } RenderResources;
 
+#define STATS_LOG_INTERVAL_MS 5000
+
+// 描画ペース（fps 上限と早送り）
+typedef struct {
+  Uint32 last_frame;
+  Uint32 window_start;
+  uint64_t window_rx;           // 窓の開始時点の rx_total
+  int window_sess;
+  int fast_forward;
+  Uint32 out_kbps;              // 直近の窓での表示中セッションの出力量
+} FramePacing;
+
+// イベントループ（epoll でタイマ・入力デバイス・起床通知を待つ。PTY はセッションのスレッドが読む）
+#define EVLOOP_TICK_MS CURSOR_BLINK_HALF_MS   // timerfd の周期（点滅があって画面が点いている間だけ動かす）
+#define EVLOOP_MAX_INPUT_FDS 8
+#define EVLOOP_MAX_EVENTS 16
+#define EVLOOP_POLL_FALLBACK_MS 12            // 入力デバイスを監視できない時は SDL を定期的に見る
+
+typedef struct {
+  int epfd;                     // -1 なら従来の SDL_Delay ループ
+  int timer_fd;
+  int tick_on;                  // timer_fd を動かしているか
+  int wake_fd;                  // eventfd: セッションの解析スレッドや SDL_PushEvent で起こす
+  int input_fds[EVLOOP_MAX_INPUT_FDS];
+  int input_fd_count;
+  int out_fds[MAX_SESSIONS];   // 書き込み待ちで EPOLLOUT を監視中の pty_fd（無ければ -1）
+  SDL_threadID main_thread;
+} EventLoop;
+
+// 計測用カウンタ（cfg.stats_log 有効時に STATS_LOG_INTERVAL_MS ごとに出力してリセット）
+typedef struct {
+  Uint32 since;
+  Uint32 frames;
+  Uint32 full_frames;
+  Uint32 partial_frames;        // 前回の画面にカーソル/ステータスだけ描き直したフレーム
+  Uint32 ff_frames;             // 早送り中に描いたフレーム
+  Uint32 coalesced;             // 描画待ちの間にまとめられた出力更新
+  Uint32 frame_us;              // render_frame に掛かった時間の合計
+  Uint32 frame_us_max;
+  Uint32 rows_drawn;
+  Uint32 rows_blitted;          // 描き直さずにずらして済ませた行
+  Uint32 fill_calls;
+  Uint32 fill_rects;
+  Uint32 geometry_calls;
+  Uint32 wakeups;               // イベントループが起きた回数
+  Uint32 pty_writes;            // PTY への write() 回数
+  Uint32 pty_write_bytes;
+} Stats;
+
 typedef struct App {
   AppConfig cfg;
 
@@ -240,11 +655,13 @@ typedef struct App {
 
   // app loop
   int quit;
-  int need_redraw;
+  int need_redraw;   // REDRAW_* のビット
+  FramePacing pacing;
 
   // sessions
   Session sessions[MAX_SESSIONS];
   int active_sess;
+  unsigned sess_lock_mask;   // UI スレッドが lock を保持しているセッション
 
   // input state
   InputState input;
@@ -266,6 +683,12 @@ typedef struct App {
 
   // render resources
   RenderResources render;
+
+  // event loop
+  EventLoop ev;
+
+  // counters
+  Stats stats;
 } App;
 
 static inline Session *SESSION(App *app) {
@@ -1,4 +1,7 @@
 #include "clipboard.h"
+#include "scrollback.h"
+#include "session.h"
+#include "term.h"
 #include "text.h"
 
 #include <SDL2/SDL.h>
@@ -128,46 +131,34 @@ static void clipboard_buf_append_utf8(App* app, uint32_t c) {
   app->clipboard.copy_buf[app->clipboard.copy_len] = '\0';
 }
 
+// 貼り付けとして流す（括弧付き貼り付けの囲みと小分けの送信は session 側で）
 static void clipboard_paste_text_to_pty(App* app, const char *s) {
   if (!s || !s[0]) return;
-  if (SESSION(app)->pty_fd >= 0) write(SESSION(app)->pty_fd, s, strlen(s));
-}
-
-// scrollback.c からコピーしたヘルパー関数（重複を避けるため static）
-static int sb_phys_index(App* app, int i) {
-  int sb_head = SESSION(app)->sb_head;
-  int sb_count = SESSION(app)->sb_count;
-  int base = sb_head - sb_count;
-  while (base < 0) base += SCROLLBACK_LINES;
-  return (base + i) % SCROLLBACK_LINES;
+  session_paste_start(SESSION(app), s, strlen(s));
 }
 
 static int sb_get_cell_virtual(App* app, int vline, int col, uint32_t *out_ch) {
   if (vline < SESSION(app)->sb_count) {
-    int p = sb_phys_index(app, vline);
-    ScrollbackCell *cell = &SESSION(app)->sb_buf[p][col];
-    *out_ch = cell->ch;
-    return (int)cell->width;
+    const ScrollbackCell *line = sb_line(SESSION(app), vline);
+    if (!line) { *out_ch = ' '; return 1; }
+    ScrollbackCell cell = line[col];
+    *out_ch = sb_cell_cp(cell);
+    return sb_cell_width(cell);
   }
 
   int vrow = vline - SESSION(app)->sb_count;
   if (vrow < 0 || vrow >= TERM_ROWS) { *out_ch = ' '; return 1; }
 
-  VTermPos pos = { .row = vrow, .col = col };
-  VTermScreenCell cell;
-  if (!vterm_screen_get_cell(SESSION(app)->vts, pos, &cell)) { *out_ch = ' '; return 1; }
-
-  if (cell.width == 0) { *out_ch = 0; return 0; }
-  *out_ch = cell.chars[0] ? cell.chars[0] : ' ';
-  return (int)cell.width;
+  const ScreenCell *cell = &term_screen_row(SESSION(app), vrow)[col];
+  *out_ch = cell->ch;
+  return cell->width;
 }
 
 static int sb_virtual_line_is_continuation(App* app, int vline) {
   if (vline < 0) return 0;
 
   if (vline < SESSION(app)->sb_count) {
-    int p = sb_phys_index(app, vline);
-    return SESSION(app)->sb_cont[p] ? 1 : 0;
+    return sb_line_cont(SESSION(app), vline);
   }
   return 0;
 }
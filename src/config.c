@@ -1,4 +1,5 @@
 #include "config.h"
+#include "term.h"
 
 #include <ctype.h>
 #include <errno.h>
@@ -39,6 +40,8 @@ int config_load_or_create(App *app, const char *appname_dir) {
     return -1;
   }
 
+  snprintf(app->cfg.config_dir, sizeof(app->cfg.config_dir), "%s", dir);
+
   char cfg_path[512];
   snprintf(cfg_path, sizeof(cfg_path), "%s/config.ini", dir);
 
@@ -58,12 +61,32 @@ int config_load_or_create(App *app, const char *appname_dir) {
   fprintf(stderr, "Config: %s\n", cfg_path);
   fprintf(stderr, " font_path='%s'\n", app->cfg.font_path);
   fprintf(stderr, " font_size=%d\n", app->cfg.font_size);
+  fprintf(stderr, " stats_log=%d\n", app->cfg.stats_log);
+  fprintf(stderr, " glyph_cache_kb=%d\n", app->cfg.glyph_cache_kb);
+  fprintf(stderr, " fps_cap=%d\n", app->cfg.fps_cap);
+  fprintf(stderr, " ff_kbps=%d\n", app->cfg.ff_kbps);
+  fprintf(stderr, " scrollback_lines=%d\n", app->cfg.scrollback_lines);
+  fprintf(stderr, " scrollback_spill=%d\n", app->cfg.scrollback_spill);
+  fprintf(stderr, " scrollback_spill_dir='%s'\n", app->cfg.scrollback_spill_dir);
+  fprintf(stderr, " foreground=#%02x%02x%02x background=#%02x%02x%02x theme_colors=0x%04x\n",
+          app->cfg.theme_fg.r, app->cfg.theme_fg.g, app->cfg.theme_fg.b,
+          app->cfg.theme_bg.r, app->cfg.theme_bg.g, app->cfg.theme_bg.b, app->cfg.theme_set);
   return 0;
 }
 
 static void config_set_defaults(App *app) {
   app->cfg.font_path[0] = '\0'; // 未指定
   app->cfg.font_size = 18;      // デフォルト
+  app->cfg.stats_log = 0;
+  app->cfg.glyph_cache_kb = CONFIG_GLYPH_CACHE_KB_DEFAULT;
+  app->cfg.fps_cap = CONFIG_FPS_CAP_DEFAULT;
+  app->cfg.ff_kbps = CONFIG_FF_KBPS_DEFAULT;
+  app->cfg.scrollback_lines = CONFIG_SCROLLBACK_LINES_DEFAULT;
+  app->cfg.scrollback_spill = 0;
+  app->cfg.scrollback_spill_dir[0] = '\0'; // 未指定なら設定ディレクトリ
+  app->cfg.theme_fg = (SDL_Color){240,240,240,255};
+  app->cfg.theme_bg = (SDL_Color){0,0,0,255};
+  app->cfg.theme_set = 0;                   // ANSI 16色は libvterm の既定のまま
 }
 
 static int config_write_default(const char *cfg_path) {
@@ -75,8 +98,34 @@ static int config_write_default(const char *cfg_path) {
     "# font_path: absolute path recommended. Empty => system fallback.\n"
     "font_path=\n"
     "font_size=18\n"
+    "# stats_log: 1 => print render statistics to stderr every 5 seconds.\n"
+    "stats_log=0\n"
+    "# glyph_cache_kb: texture memory budget for the glyph atlas (4096 KB per page).\n"
+    "glyph_cache_kb=16384\n"
+    "# fps_cap: upper bound of frames per second (0 = unlimited).\n"
+    "fps_cap=60\n"
+    "# ff_kbps: skip frames while output exceeds this many KiB/s (0 = off).\n"
+    "ff_kbps=1024\n"
+    "# scrollback_lines: history kept per session. The newest 1024 lines stay\n"
+    "#   uncompressed; older ones are stored compressed in 256-line blocks.\n"
+    "scrollback_lines=100000\n"
+    "# scrollback_spill: 1 => move history beyond scrollback_lines to a temporary\n"
+    "#   file instead of discarding it (unlimited history, deleted on exit).\n"
+    "scrollback_spill=0\n"
+    "# scrollback_spill_dir: where to create it. Empty => this config directory.\n"
+    "scrollback_spill_dir=\n"
+    "# Theme: foreground / background and color0..color15 as #rrggbb.\n"
+    "#   Unset ANSI colors keep the built-in palette (listed below).\n"
+    "foreground=#f0f0f0\n"
+    "background=#000000\n"
   );
 
+  // 組み込みパレットの値をそのまま書く（表と食い違わないように）
+  for (int i = 0; i < 16; i++) {
+    SDL_Color c = term_ansi_default_color(i);
+    fprintf(f, "#color%d=#%02x%02x%02x\n", i, c.r, c.g, c.b);
+  }
+
   fclose(f);
   return 0;
 }
@@ -107,6 +156,35 @@ static int config_load_ini(App *app, const char *cfg_path) {
     } else if (strcmp(key, "font_size") == 0) {
       int sz = atoi(val);
       if (sz >= CONFIG_FONT_SIZE_MIN && sz <= CONFIG_FONT_SIZE_MAX) app->cfg.font_size = sz;
+    } else if (strcmp(key, "stats_log") == 0) {
+      app->cfg.stats_log = atoi(val) ? 1 : 0;
+    } else if (strcmp(key, "glyph_cache_kb") == 0) {
+      int kb = atoi(val);
+      if (kb > 0) app->cfg.glyph_cache_kb = kb;
+    } else if (strcmp(key, "fps_cap") == 0) {
+      int fps = atoi(val);
+      if (fps >= 0 && fps <= CONFIG_FPS_CAP_MAX) app->cfg.fps_cap = fps;
+    } else if (strcmp(key, "ff_kbps") == 0) {
+      int kbps = atoi(val);
+      if (kbps >= 0) app->cfg.ff_kbps = kbps;
+    } else if (strcmp(key, "scrollback_lines") == 0) {
+      int n = atoi(val);
+      if (n >= 0 && n <= CONFIG_SCROLLBACK_LINES_MAX) app->cfg.scrollback_lines = n;
+    } else if (strcmp(key, "scrollback_spill") == 0) {
+      app->cfg.scrollback_spill = atoi(val) ? 1 : 0;
+    } else if (strcmp(key, "foreground") == 0) {
+      if (term_parse_color(val, &app->cfg.theme_fg) != 0) fprintf(stderr, "config: bad color %s=%s\n", key, val);
+    } else if (strcmp(key, "background") == 0) {
+      if (term_parse_color(val, &app->cfg.theme_bg) != 0) fprintf(stderr, "config: bad color %s=%s\n", key, val);
+    } else if (strncmp(key, "color", 5) == 0 && key[5]) {
+      char *end;
+      long i = strtol(key + 5, &end, 10);
+      if (*end || i < 0 || i > 15) continue;
+      if (term_parse_color(val, &app->cfg.theme[i]) == 0) app->cfg.theme_set |= (uint16_t)(1u << i);
+      else fprintf(stderr, "config: bad color %s=%s\n", key, val);
+    } else if (strcmp(key, "scrollback_spill_dir") == 0) {
+      strncpy(app->cfg.scrollback_spill_dir, val, sizeof(app->cfg.scrollback_spill_dir) - 1);
+      app->cfg.scrollback_spill_dir[sizeof(app->cfg.scrollback_spill_dir) - 1] = '\0';
     }
   }
 
@@ -0,0 +1,199 @@
+#include "evloop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// epoll_event.data.u64 の上位32bitに種別、下位に添字
+enum {
+  EVLOOP_TAG_TIMER = 1,
+  EVLOOP_TAG_WAKE,
+  EVLOOP_TAG_INPUT,
+  EVLOOP_TAG_PTY_OUT,
+};
+
+static int evloop_add(App *app, int fd, uint32_t tag, uint32_t idx);
+static void evloop_open_input_devices(App *app);
+static void evloop_drain(int fd);
+static int evloop_sdl_watch(void *userdata, SDL_Event *event);
+
+int evloop_init(App *app) {
+  EventLoop *ev = &app->ev;
+  ev->epfd = -1;
+  ev->timer_fd = -1;
+  ev->tick_on = 0;
+  ev->wake_fd = -1;
+  ev->input_fd_count = 0;
+  for (int i = 0; i < MAX_SESSIONS; i++) ev->out_fds[i] = -1;
+  ev->main_thread = SDL_ThreadID();
+
+  ev->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (ev->epfd < 0) {
+    fprintf(stderr, "epoll_create1 failed, falling back to polling: %s\n", strerror(errno));
+    return -1;
+  }
+
+  // 点滅用の周期タイマ（要る間だけ evloop_set_tick で動かす）
+  ev->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (ev->timer_fd >= 0) {
+    evloop_add(app, ev->timer_fd, EVLOOP_TAG_TIMER, 0);
+    evloop_set_tick(app, 1);
+  }
+
+  ev->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ev->wake_fd >= 0) evloop_add(app, ev->wake_fd, EVLOOP_TAG_WAKE, 0);
+
+  evloop_open_input_devices(app);
+  SDL_AddEventWatch(evloop_sdl_watch, app);
+  return 0;
+}
+
+void evloop_shutdown(App *app) {
+  EventLoop *ev = &app->ev;
+  if (ev->epfd < 0) return;
+
+  SDL_DelEventWatch(evloop_sdl_watch, app);
+
+  for (int i = 0; i < ev->input_fd_count; i++) close(ev->input_fds[i]);
+  ev->input_fd_count = 0;
+  if (ev->timer_fd >= 0) { close(ev->timer_fd); ev->timer_fd = -1; }
+  if (ev->wake_fd >= 0) { close(ev->wake_fd); ev->wake_fd = -1; }
+  close(ev->epfd);
+  ev->epfd = -1;
+}
+
+// 書き込み待ちがある間だけ pty_fd の EPOLLOUT を見る（fd を close する前に off にする）
+void evloop_watch_writable(App *app, int idx, int on) {
+  EventLoop *ev = &app->ev;
+  Session *s = &app->sessions[idx];
+  if (ev->epfd < 0) return;
+
+  if (!on || s->pty_fd < 0) {
+    if (ev->out_fds[idx] >= 0) {
+      epoll_ctl(ev->epfd, EPOLL_CTL_DEL, ev->out_fds[idx], NULL);
+      ev->out_fds[idx] = -1;
+    }
+    return;
+  }
+  if (ev->out_fds[idx] == s->pty_fd) return;
+
+  struct epoll_event e;
+  memset(&e, 0, sizeof(e));
+  e.events = EPOLLOUT;
+  e.data.u64 = ((uint64_t)EVLOOP_TAG_PTY_OUT << 32) | (uint32_t)idx;
+  if (epoll_ctl(ev->epfd, EPOLL_CTL_ADD, s->pty_fd, &e) == 0) ev->out_fds[idx] = s->pty_fd;
+}
+
+// 周期タイマを動かす／止める。止めている間、時計や電池の更新は ui_next_timeout_ms の期限で起きる
+void evloop_set_tick(App *app, int on) {
+  EventLoop *ev = &app->ev;
+  if (ev->timer_fd < 0 || ev->tick_on == on) return;
+
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));   // it_value が 0 なら停止
+  if (on) {
+    its.it_interval = (struct timespec){ EVLOOP_TICK_MS / 1000, (EVLOOP_TICK_MS % 1000) * 1000000L };
+    its.it_value = its.it_interval;
+  }
+  if (timerfd_settime(ev->timer_fd, 0, &its, NULL) == 0) ev->tick_on = on;
+}
+
+// どのスレッドからでも呼べる
+void evloop_wake(App *app) {
+  if (app->ev.wake_fd < 0) return;
+  uint64_t one = 1;
+  (void)write(app->ev.wake_fd, &one, sizeof(one));
+}
+
+// 何か起きるか timeout_ms（負なら無期限）経つまで眠る。
+// PTY の出力はセッションの解析スレッドが wake_fd で知らせ、入力は SDL_PollEvent に任せる。
+// PTY への書き込み待ちがあれば書けるようになった時にも起きる
+void evloop_wait(App *app, int timeout_ms) {
+  EventLoop *ev = &app->ev;
+
+  // 入力デバイスを見張れない時は SDL 側の入力を取りこぼさないよう定期的に起きる
+  if (ev->input_fd_count == 0 &&
+      (timeout_ms < 0 || timeout_ms > EVLOOP_POLL_FALLBACK_MS)) {
+    timeout_ms = EVLOOP_POLL_FALLBACK_MS;
+  }
+
+  struct epoll_event events[EVLOOP_MAX_EVENTS];
+  int n = epoll_wait(ev->epfd, events, EVLOOP_MAX_EVENTS, timeout_ms);
+  if (n < 0) return;   // EINTR など。次の周回でやり直す
+  app->stats.wakeups++;
+
+  for (int i = 0; i < n; i++) {
+    uint32_t tag = (uint32_t)(events[i].data.u64 >> 32);
+    uint32_t idx = (uint32_t)events[i].data.u64;
+
+    switch (tag) {
+    case EVLOOP_TAG_TIMER:
+    case EVLOOP_TAG_WAKE:
+      evloop_drain(tag == EVLOOP_TAG_TIMER ? ev->timer_fd : ev->wake_fd);
+      break;
+
+    case EVLOOP_TAG_INPUT:
+      // 中身は SDL が自分の fd で読むので、こちらは捨てるだけ
+      evloop_drain(ev->input_fds[idx]);
+      break;
+
+    case EVLOOP_TAG_PTY_OUT:
+      // 書き込みは起きた後の sessions_flush_output に任せる
+      break;
+    }
+  }
+}
+
+static int evloop_add(App *app, int fd, uint32_t tag, uint32_t idx) {
+  struct epoll_event e;
+  memset(&e, 0, sizeof(e));
+  e.events = EPOLLIN;
+  e.data.u64 = ((uint64_t)tag << 32) | idx;
+
+  if (epoll_ctl(app->ev.epfd, EPOLL_CTL_ADD, fd, &e) != 0) {
+    fprintf(stderr, "epoll_ctl(ADD, %d) failed: %s\n", fd, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+// ボタン入力で起きるため evdev を読み取り専用で別に開く（SDL の読み出しとは独立）
+static void evloop_open_input_devices(App *app) {
+  EventLoop *ev = &app->ev;
+  char path[64];
+
+  for (int i = 0; i < 32 && ev->input_fd_count < EVLOOP_MAX_INPUT_FDS; i++) {
+    snprintf(path, sizeof(path), "/dev/input/event%d", i);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) continue;
+
+    if (evloop_add(app, fd, EVLOOP_TAG_INPUT, (uint32_t)ev->input_fd_count) != 0) {
+      close(fd);
+      continue;
+    }
+    ev->input_fds[ev->input_fd_count++] = fd;
+  }
+
+  if (ev->input_fd_count == 0) {
+    fprintf(stderr, "No input device to watch, polling SDL every %d ms\n", EVLOOP_POLL_FALLBACK_MS);
+  }
+}
+
+static void evloop_drain(int fd) {
+  char buf[256];
+  while (read(fd, buf, sizeof(buf)) > 0) {}
+}
+
+// メインスレッド以外から SDL_PushEvent された時だけ起こす
+// （メインスレッドの SDL_PumpEvents 中は既に起きている）
+static int evloop_sdl_watch(void *userdata, SDL_Event *event) {
+  (void)event;
+  App *app = (App*)userdata;
+  if (SDL_ThreadID() != app->ev.main_thread) evloop_wake(app);
+  return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "app.h"
+
+int evloop_init(App *app);
+void evloop_shutdown(App *app);
+void evloop_watch_writable(App *app, int idx, int on);
+void evloop_set_tick(App *app, int on);
+void evloop_wake(App *app);
+void evloop_wait(App *app, int timeout_ms);
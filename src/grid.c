@@ -0,0 +1,220 @@
+#include "grid.h"
+#include "scrollback.h"
+#include "term.h"
+#include "util.h"
+
+#include <string.h>
+
+// VTermScreen を使わず、VTermState のコールバックから直接この画面に書く（make VTERM_BACKEND=state）。
+// セルは最初から ScrollbackCell で持つので、描画用の取り出しも scrollback への押し出しも詰め直さない
+
+#define GRID_COLOR_MASK (~(((ScrollbackCell)1 << SB_CELL_FG_SHIFT) - 1))
+#define GRID_FG_MASK    ((ScrollbackCell)0xFFF << SB_CELL_FG_SHIFT)
+#define GRID_BG_MASK    ((ScrollbackCell)0xFFF << SB_CELL_BG_SHIFT)
+
+static void grid_damage(Session *s, int r0, int r1);
+static void grid_fill(Session *s, int r0, int r1, int c0, int c1, ScrollbackCell v);
+static void grid_pen_attr(Session *s, uint8_t attr, int on);
+static void grid_push_row(Session *s, int row);
+static int grid_cb_putglyph(VTermGlyphInfo *info, VTermPos pos, void *user);
+static int grid_cb_scrollrect(VTermRect rect, int downward, int rightward, void *user);
+static int grid_cb_moverect(VTermRect dest, VTermRect src, void *user);
+static int grid_cb_erase(VTermRect rect, int selective, void *user);
+static int grid_cb_initpen(void *user);
+static int grid_cb_setpenattr(VTermAttr attr, VTermValue *val, void *user);
+static int grid_cb_settermprop(VTermProp prop, VTermValue *val, void *user);
+static int grid_cb_sb_clear(void *user);
+
+static const VTermStateCallbacks state_cb = {
+  .putglyph    = grid_cb_putglyph,
+  .scrollrect  = grid_cb_scrollrect,
+  .moverect    = grid_cb_moverect,
+  .erase       = grid_cb_erase,
+  .initpen     = grid_cb_initpen,
+  .setpenattr  = grid_cb_setpenattr,
+  .settermprop = grid_cb_settermprop,
+  .sb_clear    = grid_cb_sb_clear,
+};
+
+void grid_attach(Session *s) {
+  s->grid_alt = 0;
+  grid_cb_initpen(s);
+  grid_fill(s, 0, TERM_ROWS, 0, TERM_COLS, sb_cell_blank());
+  memset(s->grid_cont, 0, sizeof(s->grid_cont));
+
+  vterm_state_set_callbacks(s->vts_state, &state_cb, s);
+}
+
+const ScrollbackCell *grid_row(const Session *s, int row) {
+  return s->grid[s->grid_alt][row];
+}
+
+// damage を溜めずにその場で印を付ける（解析スレッドが lock 下で呼ぶ）
+static void grid_damage(Session *s, int r0, int r1) {
+  if (r0 < 0) r0 = 0;
+  if (r1 > TERM_ROWS) r1 = TERM_ROWS;
+  for (int r = r0; r < r1; r++) s->dirty_rows[r] = s->screen_stale[r] = 1;
+}
+
+static void grid_fill(Session *s, int r0, int r1, int c0, int c1, ScrollbackCell v) {
+  for (int r = r0; r < r1; r++) {
+    ScrollbackCell *row = s->grid[s->grid_alt][r];
+    for (int c = c0; c < c1; c++) row[c] = v;
+  }
+}
+
+static void grid_pen_attr(Session *s, uint8_t attr, int on) {
+  ScrollbackCell bit = (ScrollbackCell)attr << SB_CELL_ATTR_SHIFT;
+  if (on) s->grid_pen |= bit;
+  else s->grid_pen &= ~bit;
+}
+
+// 通常画面の上端から押し出される行をそのまま scrollback へ
+static void grid_push_row(Session *s, int row) {
+  uint64_t t0 = util_now_ns();
+
+  ScrollbackCell *dst = sb_store_push(s, s->grid_cont[0][row]);
+  if (dst) memcpy(dst, s->grid[0][row], sizeof(s->grid[0][row]));
+
+  atomic_fetch_add_explicit(&s->st_push_ns, util_now_ns() - t0, memory_order_relaxed);
+  atomic_fetch_add_explicit(&s->st_pushes, 1, memory_order_relaxed);
+}
+
+static int grid_cb_putglyph(VTermGlyphInfo *info, VTermPos pos, void *user) {
+  Session *s = (Session*)user;
+  if (pos.row < 0 || pos.row >= TERM_ROWS || pos.col < 0 || pos.col >= TERM_COLS) return 1;
+
+  uint32_t cp = info->chars[0] ? info->chars[0] : ' ';
+  if (cp > 0x1FFFFF) cp = 0xFFFD;
+  int width = info->width;
+  if (width < 1 || width > 2) width = 1;
+
+  ScrollbackCell *row = s->grid[s->grid_alt][pos.row];
+  row[pos.col] = (ScrollbackCell)cp | ((ScrollbackCell)width << SB_CELL_WIDTH_SHIFT) | s->grid_pen;
+  // 全角の右半分は幅0
+  if (width == 2 && pos.col + 1 < TERM_COLS) row[pos.col + 1] = s->grid_pen;
+
+  // 折り返しの印は libvterm が putglyph の直前に立てる
+  s->grid_cont[s->grid_alt][pos.row] = vterm_state_get_lineinfo(s->vts_state, pos.row)->continuation;
+
+  grid_damage(s, pos.row, pos.row + 1);
+  return 1;
+}
+
+static int grid_cb_scrollrect(VTermRect rect, int downward, int rightward, void *user) {
+  Session *s = (Session*)user;
+
+  if (downward > 0 && rightward == 0 && !s->grid_alt &&
+      rect.start_row == 0 && rect.start_col == 0 && rect.end_col == TERM_COLS) {
+    int n = downward < rect.end_row ? downward : rect.end_row;
+    for (int r = 0; r < n; r++) grid_push_row(s, r);
+  }
+
+  vterm_scroll_rect(rect, downward, rightward, grid_cb_moverect, grid_cb_erase, s);
+  return 1;
+}
+
+static int grid_cb_moverect(VTermRect dest, VTermRect src, void *user) {
+  Session *s = (Session*)user;
+  int alt = s->grid_alt;
+  int rows = src.end_row - src.start_row;
+  int cols = src.end_col - src.start_col;
+  int full = (cols == TERM_COLS);
+
+  // 重なっていても壊さないよう、下へ動かすときは下の行から
+  int up = dest.start_row <= src.start_row;
+  for (int i = 0; i < rows; i++) {
+    int k = up ? i : rows - 1 - i;
+    memmove(&s->grid[alt][dest.start_row + k][dest.start_col],
+            &s->grid[alt][src.start_row + k][src.start_col],
+            (size_t)cols * sizeof(ScrollbackCell));
+    if (full) s->grid_cont[alt][dest.start_row + k] = s->grid_cont[alt][src.start_row + k];
+  }
+
+  // 行ごとの移動は描画キャッシュも一緒にずらす（描画側はテクスチャの blit で済ませる）
+  if (full) term_screen_move_rows(s, dest.start_row, src.start_row, rows);
+  else grid_damage(s, dest.start_row, dest.end_row);
+  return 1;
+}
+
+// 消去は現在のペンの色だけを引き継ぐ（VTermScreen と同じ）。保護属性は持たないので selective も全部消す
+static int grid_cb_erase(VTermRect rect, int selective, void *user) {
+  Session *s = (Session*)user;
+  int alt = s->grid_alt;
+
+  ScrollbackCell blank = (ScrollbackCell)' ' | ((ScrollbackCell)1 << SB_CELL_WIDTH_SHIFT)
+    | (s->grid_pen & GRID_COLOR_MASK);
+  grid_fill(s, rect.start_row, rect.end_row, rect.start_col, rect.end_col, blank);
+
+  // 行末まで消えたら次の行はもう続きではない（VTermState の lineinfo と揃える）
+  if (rect.end_col == TERM_COLS) {
+    int r0 = rect.start_col == 0 ? rect.start_row : rect.start_row + 1;
+    for (int r = r0; r <= rect.end_row && r < TERM_ROWS; r++) s->grid_cont[alt][r] = 0;
+  }
+
+  grid_damage(s, rect.start_row, rect.end_row);
+  return 1;
+}
+
+static int grid_cb_initpen(void *user) {
+  Session *s = (Session*)user;
+  s->grid_pen = ((ScrollbackCell)SB_COLOR_DEFAULT_FG << SB_CELL_FG_SHIFT)
+              | ((ScrollbackCell)SB_COLOR_DEFAULT_BG << SB_CELL_BG_SHIFT);
+  return 1;
+}
+
+// 色は SGR のたびに一度だけ色IDへ引く。putglyph はペンを OR するだけ
+static int grid_cb_setpenattr(VTermAttr attr, VTermValue *val, void *user) {
+  Session *s = (Session*)user;
+  if (attr == VTERM_ATTR_FOREGROUND || attr == VTERM_ATTR_BACKGROUND) sb_colors_maybe_sweep(s);
+
+  switch (attr) {
+  case VTERM_ATTR_BOLD:    grid_pen_attr(s, CELL_ATTR_BOLD, val->boolean); break;
+  case VTERM_ATTR_ITALIC:  grid_pen_attr(s, CELL_ATTR_ITALIC, val->boolean); break;
+  case VTERM_ATTR_BLINK:   grid_pen_attr(s, CELL_ATTR_BLINK, val->boolean); break;
+  case VTERM_ATTR_REVERSE: grid_pen_attr(s, CELL_ATTR_REVERSE, val->boolean); break;
+  case VTERM_ATTR_STRIKE:  grid_pen_attr(s, CELL_ATTR_STRIKE, val->boolean); break;
+  case VTERM_ATTR_UNDERLINE:
+    grid_pen_attr(s, CELL_ATTR_UNDERLINE | CELL_ATTR_DUNDERLINE, 0);
+    if (val->number == VTERM_UNDERLINE_DOUBLE) grid_pen_attr(s, CELL_ATTR_DUNDERLINE, 1);
+    else if (val->number) grid_pen_attr(s, CELL_ATTR_UNDERLINE, 1);
+    break;
+  case VTERM_ATTR_FOREGROUND:
+    s->grid_pen = (s->grid_pen & ~GRID_FG_MASK)
+                | ((ScrollbackCell)sb_color_id(&s->sb_colors, val->color) << SB_CELL_FG_SHIFT);
+    break;
+  case VTERM_ATTR_BACKGROUND:
+    s->grid_pen = (s->grid_pen & ~GRID_BG_MASK)
+                | ((ScrollbackCell)sb_color_id(&s->sb_colors, val->color) << SB_CELL_BG_SHIFT);
+    break;
+  default:
+    break;  // conceal / font / small / baseline は描画に使っていない
+  }
+  return 1;
+}
+
+static int grid_cb_settermprop(VTermProp prop, VTermValue *val, void *user) {
+  Session *s = (Session*)user;
+  if (prop != VTERM_PROP_ALTSCREEN) return 1;
+
+  int alt = val->boolean ? 1 : 0;
+  if (alt == s->grid_alt) return 1;
+
+  // 代替画面は入るたびに空から。抜けたら通常画面がそのまま戻る
+  s->grid_alt = alt;
+  if (alt) {
+    ScrollbackCell blank = (ScrollbackCell)' ' | ((ScrollbackCell)1 << SB_CELL_WIDTH_SHIFT)
+      | (s->grid_pen & GRID_COLOR_MASK);
+    grid_fill(s, 0, TERM_ROWS, 0, TERM_COLS, blank);
+    memset(s->grid_cont[1], 0, sizeof(s->grid_cont[1]));
+  }
+  grid_damage(s, 0, TERM_ROWS);
+  return 1;
+}
+
+static int grid_cb_sb_clear(void *user) {
+  Session *s = (Session*)user;
+  sb_store_clear(s);
+  s->view_offset_lines = 0;
+  return 1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "app.h"
+
+void grid_attach(Session *s);
+const ScrollbackCell *grid_row(const Session *s, int row);
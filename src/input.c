@@ -1,12 +1,17 @@
 #include "input.h"
 #include "clipboard.h"
+#include "render.h"
 #include "session.h"
+#include "strcache.h"
+#include "text.h"
 #include "ui.h"
 #include "term.h"
 #include "util.h"
 #include "scrollback.h"
+#include "search.h"
 
 static void input_mod_cycle(ModState *s);
+static void input_cursor_mode_exit(App *app);
 static int input_is_modifier_token(const char *k);
 static int input_wake_handle_event(App *app, int btn);
 
@@ -39,6 +44,21 @@ static void handle_btn_right(App* app);
 void input_handle_input(App* app) {
   SDL_Event e;
   while (SDL_PollEvent(&e)) {
+    if (e.type == SDL_RENDER_TARGETS_RESET) {
+      // ターゲットテクスチャの中身が失われたので描き直す
+      render_invalidate(app);
+      app->need_redraw |= REDRAW_ALL;
+      continue;
+    }
+    if (e.type == SDL_RENDER_DEVICE_RESET) {
+      // テクスチャ自体が失われたので作り直す
+      render_shutdown(app);
+      glyph_cache_clear(app);
+      strcache_clear(app);
+      app->need_redraw |= REDRAW_ALL;
+      continue;
+    }
+
     if (app->backlight.screen_blank) {
       if (e.type == SDL_JOYBUTTONDOWN) {
         input_wake_handle_event(app, e.jbutton.button);
@@ -111,10 +131,12 @@ void input_session_menu(App* app, int btn) {
 }
 
 void input_send_key(App* app, const char *k) {
-  if (strcmp(k, "Ctrl") == 0) { input_mod_cycle(&app->input.mod_ctrl); app->need_redraw = 1; return; }
-  if (strcmp(k, "Shift") == 0) { input_mod_cycle(&app->input.mod_shift); app->need_redraw = 1; return; }
-  if (strcmp(k, "Alt") == 0)   { input_mod_cycle(&app->input.mod_alt); app->need_redraw = 1; return; }
-  if (strcmp(k, "Meta") == 0)  { input_mod_cycle(&app->input.mod_meta); app->need_redraw = 1; return; }
+  if (SESSION(app)->search.active) { search_input_key(app, k); return; }
+
+  if (strcmp(k, "Ctrl") == 0) { input_mod_cycle(&app->input.mod_ctrl); app->need_redraw |= REDRAW_ALL; return; }
+  if (strcmp(k, "Shift") == 0) { input_mod_cycle(&app->input.mod_shift); app->need_redraw |= REDRAW_ALL; return; }
+  if (strcmp(k, "Alt") == 0)   { input_mod_cycle(&app->input.mod_alt); app->need_redraw |= REDRAW_ALL; return; }
+  if (strcmp(k, "Meta") == 0)  { input_mod_cycle(&app->input.mod_meta); app->need_redraw |= REDRAW_ALL; return; }
 
   if (strcmp(k, "SP") == 0) { term_pty_send_byte_with_altmeta(app, ' '); input_mods_consume_oneshot(app); return; }
   if (strcmp(k, "BS") == 0) { term_pty_send_byte_with_altmeta(app, 0x7f); input_mods_consume_oneshot(app); return; }
@@ -131,11 +153,7 @@ void input_send_key(App* app, const char *k) {
       app->input.kbd_sel_row = CUR_KEY_ROW;
       app->input.kbd_sel_col = CUR_KEY_COL;
     } else {
-      app->input.cursor_mode = 0;
-      app->input.kbd_sel_row = app->input.saved_kbd_row;
-      app->input.kbd_sel_col = app->input.saved_kbd_col;
-
-      SESSION(app)->region_mode = 0;
+      input_cursor_mode_exit(app);
     }
     return;
   }
@@ -163,6 +181,14 @@ static void input_mod_cycle(ModState *s) {
   else *s = MOD_OFF; // LOCKED -> OFF
 }
 
+static void input_cursor_mode_exit(App *app) {
+  app->input.cursor_mode = 0;
+  app->input.kbd_sel_row = app->input.saved_kbd_row;
+  app->input.kbd_sel_col = app->input.saved_kbd_col;
+
+  SESSION(app)->region_mode = 0;
+}
+
 static int input_is_modifier_token(const char *k) {
   return strcmp(k, "Ctrl") == 0 ||
          strcmp(k, "Alt") == 0 ||
@@ -192,7 +218,9 @@ static int input_wake_handle_event(App *app, int btn) {
 }
 
 static void handle_btn_b(App* app) {
-  if (SESSION(app)->region_mode) {
+  if (SESSION(app)->search.active) {
+    search_input_key(app, "BS");
+  } else if (SESSION(app)->region_mode) {
     if (SESSION(app)->selecting) {
       SESSION(app)->selecting = 0;
     } else {
@@ -209,7 +237,9 @@ static void handle_btn_a(App* app) {
 }
 
 static void handle_btn_x(App* app) {
-  if (SESSION(app)->region_mode) {
+  if (SESSION(app)->search.active) {
+    search_step(app, -1);
+  } else if (SESSION(app)->region_mode) {
     if (!SESSION(app)->selecting) {
       SESSION(app)->selecting = 1;
       SESSION(app)->sel_line = SESSION(app)->reg_line;
@@ -226,20 +256,30 @@ static void handle_btn_x(App* app) {
 }
 
 static void handle_btn_y(App* app) {
-  if (SESSION(app)->region_mode) {
+  if (SESSION(app)->search.active) {
+    search_step(app, 1);
+  } else if (SESSION(app)->region_mode) {
     clipboard_copy_selection(app);
     sb_region_exit(app);
+  } else if (app->input.cursor_mode) {
+    // 検索語の入力にソフトウェアキーボードを使うのでカーソルモードは抜ける
+    input_cursor_mode_exit(app);
+    search_enter(app);
   } else {
     input_send_key(app, "SP");
   }
 }
 
 static void handle_btn_l1(App* app) {
-  app->input.kbd_layer = (app->input.kbd_layer + 1) % 3;
+  app->input.kbd_layer = (app->input.kbd_layer + 1) % KEY_LAYERS;
 }
 
 static void handle_btn_r1(App* app) {
-  input_send_key(app, "Tab");
+  if (SESSION(app)->search.active) {
+    search_accept(app);
+  } else {
+    input_send_key(app, "Tab");
+  }
 }
 
 static void handle_btn_l2(App* app) {
@@ -334,7 +374,7 @@ static void handle_button_down_event(App* app, int btn, InputRepeatState* state)
     }
     app->pending.paste_pending = 1;
     app->pending.paste_pending_since = SDL_GetTicks();
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_ALL;
     return;
   }
 
@@ -347,20 +387,20 @@ static void handle_button_down_event(App* app, int btn, InputRepeatState* state)
   if (btn == BTN_MENU) {
     if (!app->ui.menu_active) ui_session_menu_open(app);
     else ui_session_menu_close(app);
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_ALL;
     state->active_button = -1;
     return;
   }
 
   if (app->ui.menu_active) {
     input_session_menu(app, btn);
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_ALL;
   } else {
     state->active_button = btn;
     state->last_repeat_time = SDL_GetTicks();
     state->repeat_count = 0;
     input_key_move(app, state->active_button);
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_ALL;
   }
 }
 
@@ -379,6 +419,17 @@ static void handle_button_up_event(App* app, int btn, InputRepeatState* state) {
   }
 }
 
+// 次のキーリピートまでの残り ms。リピート中でなければ -1
+int input_next_timeout_ms(App *app) {
+  (void)app;
+  InputRepeatState *state = &g_repeat_state;
+  if (state->active_button == -1 || !util_is_dpad(state->active_button)) return -1;
+
+  Uint32 delay = (state->repeat_count == 0) ? BUTTON_REPEAT_INITIAL_DELAY_MS : BUTTON_REPEAT_INTERVAL_MS;
+  Uint32 elapsed = SDL_GetTicks() - state->last_repeat_time;
+  return (elapsed > delay) ? 0 : (int)(delay - elapsed) + 1;
+}
+
 static void handle_button_repeat(App* app, InputRepeatState* state) {
   if (state->active_button == -1 || !util_is_dpad(state->active_button)) {
     return;
@@ -393,7 +444,7 @@ static void handle_button_repeat(App* app, InputRepeatState* state) {
     } else {
       input_key_move(app, state->active_button);
     }
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_ALL;
     state->last_repeat_time = now;
     state->repeat_count++;
   }
@@ -1,7 +1,7 @@
 #pragma once
 #include "app.h"
 
-static const KeyDefinition layers[3][KEY_ROWS][KEY_COLS] = {
+static const KeyDefinition layers[KEY_LAYERS][KEY_ROWS][KEY_COLS] = {
   {
     { {"⎋","Esc"},{"󰘴","Ctrl"},{"󰘶","Shift"},{"󰘵","Alt"},{"󰘳","Meta"},{"(","("},{")",")"},{"-","-"},{"|","|"},{"","CUR"} },
     { {"q","q"},{"w","w"},{"e","e"},{"r","r"},{"t","t"},{"y","y"},{"u","u"},{"i","i"},{"o","o"},{"p","p"} },
@@ -22,7 +22,7 @@ static const KeyDefinition layers[3][KEY_ROWS][KEY_COLS] = {
   }
 };
 
-static const KeyDefinition layers_ascii[3][KEY_ROWS][KEY_COLS] = {
+static const KeyDefinition layers_ascii[KEY_LAYERS][KEY_ROWS][KEY_COLS] = {
   {
     { {"Ctrl","Ctrl"},{"Alt","Alt"},{"Meta","Meta"},{"Shift","Shift"},{"Tab","Tab"},{"Esc","Esc"},{"SP","SP"},{"BS","BS"},{"ENT","ENT"},{"CUR","CUR"} },
     { {"q","q"},{"w","w"},{"e","e"},{"r","r"},{"t","t"},{"y","y"},{"u","u"},{"i","i"},{"o","o"},{"p","p"} },
@@ -52,3 +52,4 @@ void input_key_move(App* app, int btn);
 void input_session_menu(App* app, int btn);
 void input_send_key(App* app, const char *k);
 void input_mods_consume_oneshot(App *app);
+int input_next_timeout_ms(App *app);
@@ -4,34 +4,123 @@
 #include "text.h"
 #include "term.h"
 #include "scrollback.h"
+#include "session.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 static void render_blank_screen(App* app);
-static void render_status_bar(App* app);
-static void render_terminal_area(App* app);
+static void render_frame_patch(App* app, int what);
+static void render_target_reset(App* app);
+static void render_status_bar(App* app, int update);
+static void render_status_bar_contents(App* app, const StatusLayerSig *sig);
+static void render_status_sig(App* app, StatusLayerSig *sig);
+static int render_layer_ensure(App* app, SDL_Texture **tex, int w, int h);
+static void render_layer_begin(App* app, SDL_Texture *tex);
+static void render_terminal_area(App* app, int update);
+static int render_term_texture_ensure(App* app);
+static int render_term_shift(const RenderResources *rr, const uint64_t *ids);
+static void render_term_scroll(App* app, int shift);
+static void render_draw_term_row(App* app, int screen_r, int vline, int hl_from, int hl_to);
+static void render_span_add(App* app, BgSpanBatch *b, const SDL_Rect *rect, SDL_Color color);
+static void render_span_flush(App* app, BgSpanBatch *b);
+static void render_glyph_batch_add(App* app, const GlyphCacheEntry *g, const SDL_Rect *cell, SDL_Color fg);
 static void render_menu_overlay_if_active(App* app);
+static void render_menu_sig(App* app, MenuLayerSig *sig);
 static void render_keyboard(App* app);
+static void render_keyboard_keys(App* app, int layer, int oy, int draw_selection);
+static void render_keyboard_key(App* app, int layer, int r, int c, int oy, int selected);
 static void render_cursor_or_region(App* app);
 
-void render_frame(App* app) {
+// what: REDRAW_* のビット。REDRAW_ALL / REDRAW_OUTPUT を含まなければ部分フレームとして、
+// 前回合成した画面（frame_tex）のカーソルのセルとステータスバーだけを描き直して出す
+void render_frame(App* app, int what) {
   if (app->backlight.screen_blank) {
     render_blank_screen(app);
     return;
   }
 
-  SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
-  SDL_RenderClear(app->renderer);
-
-  render_status_bar(app);
-  render_terminal_area(app);
-  render_menu_overlay_if_active(app);
-  render_keyboard(app);
-  render_cursor_or_region(app);
+  RenderResources *rr = &app->render;
+  int full = (what & (REDRAW_ALL | REDRAW_OUTPUT)) || !rr->term_valid || !rr->status_tex || rr->status_dirty;
+
+  int st = render_layer_ensure(app, &rr->frame_tex, SCREEN_W, SCREEN_H);
+  if (st != 0) rr->frame_valid = 0;
+
+  if (!full && rr->frame_valid) {
+    render_frame_patch(app, what);
+  } else {
+    // レンダーターゲット非対応なら frame_tex は NULL で、画面へ直接描く
+    render_target_reset(app);
+    SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
+    SDL_RenderClear(app->renderer);
+
+    if (full) rr->blink_on = ((SDL_GetTicks() / TEXT_BLINK_HALF_MS) % 2) == 0;
+
+    render_status_bar(app, full || (what & REDRAW_STATUS));
+    render_terminal_area(app, full);
+    render_menu_overlay_if_active(app);
+    render_keyboard(app);
+    rr->frame_cursor_on = 0;
+    render_cursor_or_region(app);
+    rr->frame_valid = rr->frame_tex != NULL;
+  }
 
+  if (rr->frame_tex) {
+    SDL_SetRenderTarget(app->renderer, NULL);
+    SDL_RenderCopy(app->renderer, rr->frame_tex, NULL, NULL);
+  }
   SDL_RenderPresent(app->renderer);
+  app->stats.frames++;
+  if (full) app->stats.full_frames++;
+  else app->stats.partial_frames++;
+}
+
+// カーソルの点滅と時計・電池の更新。端末・メニュー・キーボードは前回のまま触らない。
+// 消すカーソルの下は端末テクスチャの同じセルから戻す
+static void render_frame_patch(App* app, int what) {
+  RenderResources *rr = &app->render;
+  render_target_reset(app);
+
+  if (what & REDRAW_STATUS) render_status_bar(app, 1);
+
+  if (rr->frame_cursor_on) {
+    SDL_Rect src = rr->frame_cursor;
+    src.y -= TERM_Y;
+    SDL_RenderCopy(app->renderer, rr->term_tex, &src, &rr->frame_cursor);
+    rr->frame_cursor_on = 0;
+  }
+  // 領域選択の枠は動かない限り描いたまま（動けば全体フレーム）
+  if (!SESSION(app)->region_mode) render_cursor_or_region(app);
+}
+
+// 描き終わったレイヤの後は合成先（frame_tex、無ければ画面）へ戻す
+static void render_target_reset(App* app) {
+  SDL_SetRenderTarget(app->renderer, app->render.frame_tex);
+}
+
+void render_invalidate(App* app) {
+  RenderResources *rr = &app->render;
+  rr->term_valid = 0;
+  rr->status_dirty = 1;
+  rr->menu_dirty = 1;
+  rr->frame_valid = 0;
+  for (int i = 0; i < KEY_LAYERS; i++) rr->kbd_dirty[i] = 1;
 }
 
+void render_shutdown(App* app) {
+  RenderResources *rr = &app->render;
+  SDL_Texture **texs[] = { &rr->term_tex, &rr->term_tex_back, &rr->status_tex, &rr->menu_tex, &rr->frame_tex };
+  for (size_t i = 0; i < sizeof(texs) / sizeof(texs[0]); i++) {
+    if (*texs[i]) { SDL_DestroyTexture(*texs[i]); *texs[i] = NULL; }
+  }
+  for (int i = 0; i < KEY_LAYERS; i++) {
+    if (rr->kbd_tex[i]) { SDL_DestroyTexture(rr->kbd_tex[i]); rr->kbd_tex[i] = NULL; }
+  }
+  render_invalidate(app);
+}
+
+// 端末領域ローカル座標（左上が (0,0)）で全行を描く
 void render_draw_with_scrollback(App* app) {
   int start = sb_virtual_start_line(app);
 
@@ -40,71 +129,70 @@ void render_draw_with_scrollback(App* app) {
 
     int hl_from, hl_to;
     sb_region_line_hl_range(app, vline, &hl_from, &hl_to);
+    render_draw_term_row(app, r, vline, hl_from, hl_to);
+  }
+}
 
-    if (vline < SESSION(app)->sb_count) {
-      render_draw_scrollback_line(app, vline, r, hl_from, hl_to);
-    } else {
-      int vrow = vline - SESSION(app)->sb_count;
-      if (vrow >= 0 && vrow < TERM_ROWS)
-        render_draw_vterm_line(app, vrow, r, hl_from, hl_to);
-    }
+static void render_draw_term_row(App* app, int screen_r, int vline, int hl_from, int hl_to) {
+  if (vline < SESSION(app)->sb_count) {
+    render_draw_scrollback_line(app, vline, screen_r, hl_from, hl_to);
+  } else {
+    int vrow = vline - SESSION(app)->sb_count;
+    if (vrow >= 0 && vrow < TERM_ROWS)
+      render_draw_vterm_line(app, vrow, screen_r, hl_from, hl_to);
   }
 }
 
 void render_draw_vterm_line(App* app, int vterm_row, int screen_r, int hl_from, int hl_to) {
-  VTermPos pos;
-  VTermScreenCell cell;
+  const ScreenCell *row = term_screen_row(SESSION(app), vterm_row);
 
   for (int c = 0; c < TERM_COLS; c++) {
-    pos.row = vterm_row;
-    pos.col = c;
-
-    if (!vterm_screen_get_cell(SESSION(app)->vts, pos, &cell))
-      continue;
-
-    if (cell.width == 0) continue;
-
-    uint32_t ch = cell.chars[0] ? cell.chars[0] : ' ';
-    SDL_Color fg = term_fg_to_sdl(app, SESSION(app)->vts_state, cell.fg);
-    SDL_Color bg = term_bg_to_sdl(app, SESSION(app)->vts_state, cell.bg);
+    const ScreenCell *cell = &row[c];
+    if (cell->width == 0) continue;
 
-    if (cell.attrs.reverse) { SDL_Color tmp = fg; fg = bg; bg = tmp; }
+    SDL_Color fg = cell->fg;
+    SDL_Color bg = cell->bg;
+    if (cell->attrs & CELL_ATTR_REVERSE) { SDL_Color tmp = fg; fg = bg; bg = tmp; }
 
     int hl = (c >= hl_from && c <= hl_to) ? 1 : 0;
 
-    int wide = (cell.width == 2) ? 1 : 0;
-    render_draw_cell_rgb(app, c * FONT_W, TERM_Y + screen_r * FONT_H, ch, fg, bg, hl, wide);
+    int wide = (cell->width == 2) ? 1 : 0;
+    render_draw_cell_rgb(app, c * FONT_W, screen_r * FONT_H, cell->ch, fg, bg, cell->attrs, hl, wide);
 
-    if (cell.width == 2) c++;
+    if (cell->width == 2) c++;
   }
 }
 
 void render_draw_scrollback_line(App* app, int logical_i, int screen_r, int hl_from, int hl_to) {
-  int p = sb_phys_index(app, logical_i);
-  ScrollbackCell *line = SESSION(app)->sb_buf[p];
+  Session *s = SESSION(app);
+  const ScrollbackCell *line = sb_line(s, logical_i);
+  if (!line) return;
 
   for (int c = 0; c < TERM_COLS; c++) {
-    ScrollbackCell *cell = &line[c];
+    ScrollbackCell cell = line[c];
+    int width = sb_cell_width(cell);
 
-    if (cell->width == 0) continue;
+    if (width == 0) continue;
 
-    SDL_Color fg = cell->fg;
-    SDL_Color bg = cell->bg;
-    if (cell->reverse) { SDL_Color tmp = fg; fg = bg; bg = tmp; }
+    uint8_t attrs = sb_cell_attrs(cell);
+    SDL_Color fg = sb_color_to_sdl(app, s, sb_cell_fg(cell));
+    SDL_Color bg = sb_color_to_sdl(app, s, sb_cell_bg(cell));
+    if (attrs & CELL_ATTR_REVERSE) { SDL_Color tmp = fg; fg = bg; bg = tmp; }
 
     int hl = (c >= hl_from && c <= hl_to) ? 1 : 0;
-    int wide = (cell->width == 2) ? 1 : 0;
+    int wide = (width == 2) ? 1 : 0;
+    uint32_t ch = sb_cell_cp(cell);
 
-    render_draw_cell_rgb(app, c * FONT_W, TERM_Y + screen_r * FONT_H,
-                  cell->ch ? cell->ch : ' ', fg, bg, hl, wide);
+    render_draw_cell_rgb(app, c * FONT_W, screen_r * FONT_H,
+                  ch ? ch : ' ', fg, bg, attrs, hl, wide);
 
-    if (cell->width == 2) c++;
+    if (width == 2) c++;
   }
 }
 
 void render_draw_cell_rgb(App* app,
 		   int x, int y, uint32_t c,
-		   SDL_Color fg_c, SDL_Color bg_c,
+		   SDL_Color fg_c, SDL_Color bg_c, uint8_t attrs,
 		   int highlight, int wide) {
   if (wide == 2) return;
 
@@ -112,25 +200,148 @@ void render_draw_cell_rgb(App* app,
   SDL_Rect cell = { x, y, draw_w, FONT_H };
 
   SDL_Color bg = highlight ? (SDL_Color){HIGHLIGHT_BG_R, HIGHLIGHT_BG_G, HIGHLIGHT_BG_B, 255} : bg_c;
-  SDL_SetRenderDrawColor(app->renderer, bg.r, bg.g, bg.b, 255);
-  SDL_RenderFillRect(app->renderer, &cell);
+  render_span_add(app, &app->render.bg_spans, &cell, bg);
+
+  // 点滅セルは消灯側の位相では背景だけ
+  if (attrs & CELL_ATTR_BLINK) {
+    int row = y / FONT_H;
+    if (row >= 0 && row < TERM_ROWS) app->render.term_row_blink[row] = 1;
+    if (!app->render.blink_on) return;
+  }
 
   SDL_Color fg = highlight ? (SDL_Color){255, 255, 255, 255} : fg_c;
+  if (attrs & CELL_ATTR_DIM) {
+    fg.r = (uint8_t)((fg.r + bg.r) / 2);
+    fg.g = (uint8_t)((fg.g + bg.g) / 2);
+    fg.b = (uint8_t)((fg.b + bg.b) / 2);
+  }
 
-  int gw = 0, gh = 0;
-  SDL_Texture *tex = glyph_get_texture(app, c, &gw, &gh);
-  if (!tex) return;
+  // 下線・取り消し線は背景と同じ要領で矩形をまとめ、グリフの後に描く
+  if (attrs & (CELL_ATTR_UNDERLINE | CELL_ATTR_DUNDERLINE)) {
+    SDL_Rect ul = { x, y + FONT_H - 2, draw_w, 1 };
+    render_span_add(app, &app->render.deco_spans, &ul, fg);
+    if (attrs & CELL_ATTR_DUNDERLINE) {
+      ul.y -= 2;
+      render_span_add(app, &app->render.deco_spans, &ul, fg);
+    }
+  }
+  if (attrs & CELL_ATTR_STRIKE) {
+    SDL_Rect st = { x, y + FONT_H / 2, draw_w, 1 };
+    render_span_add(app, &app->render.deco_spans, &st, fg);
+  }
 
-  SDL_SetTextureColorMod(tex, fg.r, fg.g, fg.b);
+  // 空白はグリフ不要
+  if (c == ' ' || c == 0) return;
 
-  SDL_Rect dst = {
-    x + (draw_w - gw) / 2,
-    y + (FONT_H - gh) / 2,
-    gw,
-    gh
-  };
+  const GlyphCacheEntry *g = glyph_lookup(app, c, attrs & GLYPH_STYLE_MASK);
+  if (!g) return;
 
-  SDL_RenderCopy(app->renderer, tex, NULL, &dst);
+  render_glyph_batch_add(app, g, &cell, fg);
+}
+
+// 既定背景色の背景は描かない（行は既定色でクリア済み）。
+// 直前の矩形と同じ行・同じ色で隣接していれば横に伸ばす。
+static void render_span_add(App* app, BgSpanBatch *b, const SDL_Rect *rect, SDL_Color color) {
+  if (b == &app->render.bg_spans) {
+    SDL_Color def = app->render.def_bg;
+    if (color.r == def.r && color.g == def.g && color.b == def.b) return;
+  }
+
+  if (b->count > 0) {
+    SDL_Rect *last = &b->rects[b->count - 1];
+    SDL_Color lc = b->colors[b->count - 1];
+    if (last->y == rect->y && last->h == rect->h && last->x + last->w == rect->x &&
+        lc.r == color.r && lc.g == color.g && lc.b == color.b) {
+      last->w += rect->w;
+      return;
+    }
+  }
+
+  if (b->count >= BG_SPAN_MAX) render_cells_flush(app);
+
+  b->rects[b->count] = *rect;
+  b->colors[b->count] = (SDL_Color){ color.r, color.g, color.b, 255 };
+  b->count++;
+}
+
+// 色ごとに1回の SDL_RenderFillRects にまとめる
+static void render_span_flush(App* app, BgSpanBatch *b) {
+  for (int i = 0; i < b->count; i++) {
+    if (b->colors[i].a == 0) continue;   // 出力済み
+    SDL_Color c = b->colors[i];
+
+    int n = 0;
+    for (int j = i; j < b->count; j++) {
+      SDL_Color cj = b->colors[j];
+      if (cj.a == 0 || cj.r != c.r || cj.g != c.g || cj.b != c.b) continue;
+      b->scratch[n++] = b->rects[j];
+      b->colors[j].a = 0;
+    }
+
+    SDL_SetRenderDrawColor(app->renderer, c.r, c.g, c.b, 255);
+    SDL_RenderFillRects(app->renderer, b->scratch, n);
+    app->stats.fill_calls++;
+    app->stats.fill_rects += (Uint32)n;
+  }
+  b->count = 0;
+}
+
+// セル矩形にクリップしたクアッドをページ別バッファに積む（描画は flush でまとめて）
+static void render_glyph_batch_add(App* app, const GlyphCacheEntry *g, const SDL_Rect *cell, SDL_Color fg) {
+  GlyphBatch *b = &app->render.batch;
+  if (b->quads[g->page] >= GLYPH_BATCH_QUADS) render_cells_flush(app);
+
+  float x0 = (float)(cell->x + (cell->w - g->w) / 2);
+  float y0 = (float)(cell->y + (cell->h - g->h) / 2);
+  float x1 = x0 + g->w;
+  float y1 = y0 + g->h;
+  float u0 = (float)g->x, v0 = (float)g->y;
+  float u1 = u0 + g->w,  v1 = v0 + g->h;
+
+  float cx0 = (float)cell->x, cy0 = (float)cell->y;
+  float cx1 = cx0 + cell->w,  cy1 = cy0 + cell->h;
+  if (x0 < cx0) { u0 += cx0 - x0; x0 = cx0; }
+  if (y0 < cy0) { v0 += cy0 - y0; y0 = cy0; }
+  if (x1 > cx1) { u1 -= x1 - cx1; x1 = cx1; }
+  if (y1 > cy1) { v1 -= y1 - cy1; y1 = cy1; }
+  if (x1 <= x0 || y1 <= y0) return;
+
+  const float inv = 1.0f / GLYPH_ATLAS_SIZE;
+  SDL_Vertex *v = &b->verts[g->page][b->quads[g->page] * 4];
+  v[0] = (SDL_Vertex){ { x0, y0 }, fg, { u0 * inv, v0 * inv } };
+  v[1] = (SDL_Vertex){ { x1, y0 }, fg, { u1 * inv, v0 * inv } };
+  v[2] = (SDL_Vertex){ { x0, y1 }, fg, { u0 * inv, v1 * inv } };
+  v[3] = (SDL_Vertex){ { x1, y1 }, fg, { u1 * inv, v1 * inv } };
+  b->quads[g->page]++;
+}
+
+// 積んだセルを 背景 → グリフ → 下線・取り消し線 の順に描く
+void render_cells_flush(App* app) {
+  GlyphBatch *b = &app->render.batch;
+
+  render_span_flush(app, &app->render.bg_spans);
+
+  if (!b->indices_ready) {
+    for (int q = 0; q < GLYPH_BATCH_QUADS; q++) {
+      int *ix = &b->indices[q * 6];
+      ix[0] = q * 4 + 0; ix[1] = q * 4 + 1; ix[2] = q * 4 + 2;
+      ix[3] = q * 4 + 2; ix[4] = q * 4 + 1; ix[5] = q * 4 + 3;
+    }
+    b->indices_ready = 1;
+  }
+
+  for (int p = 0; p < GLYPH_ATLAS_PAGES; p++) {
+    int n = b->quads[p];
+    if (n == 0) continue;
+    SDL_Texture *tex = glyph_atlas_texture(app, p);
+    if (tex) {
+      SDL_RenderGeometry(app->renderer, tex, b->verts[p], n * 4, b->indices, n * 6);
+      app->stats.geometry_calls++;
+    }
+    b->quads[p] = 0;
+  }
+
+  render_span_flush(app, &app->render.deco_spans);
 }
 
 static void render_blank_screen(App* app) {
@@ -139,15 +350,71 @@ static void render_blank_screen(App* app) {
   SDL_RenderPresent(app->renderer);
 }
 
-static void render_status_bar(App* app) {
+static void render_status_bar(App* app, int update) {
+  RenderResources *rr = &app->render;
+  SDL_Rect dst = { 0, STATUS_Y, SCREEN_W, FONT_H + 2 };
+
+  if (!update && rr->status_tex && !rr->status_dirty) {
+    SDL_RenderCopy(app->renderer, rr->status_tex, NULL, &dst);
+    return;
+  }
+
+  StatusLayerSig sig;
+  render_status_sig(app, &sig);
+
+  int st = render_layer_ensure(app, &rr->status_tex, dst.w, dst.h);
+  if (st < 0) {
+    render_status_bar_contents(app, &sig);
+    return;
+  }
+
+  // 表示内容が変わった時だけ描き直す（分の変化・電池残量・キー操作など）
+  if (st > 0 || rr->status_dirty || memcmp(&sig, &rr->status_sig, sizeof(sig)) != 0) {
+    render_layer_begin(app, rr->status_tex);
+    render_status_bar_contents(app, &sig);
+    render_target_reset(app);
+    rr->status_sig = sig;
+    rr->status_dirty = 0;
+  }
+
+  SDL_RenderCopy(app->renderer, rr->status_tex, NULL, &dst);
+}
+
+static void render_status_sig(App* app, StatusLayerSig *sig) {
+  memset(sig, 0, sizeof(*sig));
+  sig->kbd_layer = app->input.kbd_layer;
+  sig->mod_ctrl = app->input.mod_ctrl;
+  sig->mod_alt = app->input.mod_alt;
+  sig->mod_meta = app->input.mod_meta;
+  sig->mod_shift = app->input.mod_shift;
+  sig->cursor_mode = app->input.cursor_mode;
+  sig->region_mode = SESSION(app)->region_mode;
+  sig->selecting = SESSION(app)->selecting;
+  sig->paste_pct = session_paste_progress(SESSION(app));
+  sig->search_active = SESSION(app)->search.active;
+  sig->search_seq = SESSION(app)->search.seq;
+
+  int batt_lv = (app->status_cache.cached_batt >= 0) ? app->status_cache.cached_batt : battery_get_level();
+  if (batt_lv < 0) batt_lv = 0;
+  sig->batt = batt_lv;
+
+  time_t t = time(NULL);
+  struct tm *tm_now = localtime(&t);
+  if (tm_now) {
+    sig->hour = tm_now->tm_hour;
+    sig->minute = tm_now->tm_min;
+  }
+}
+
+static void render_status_bar_contents(App* app, const StatusLayerSig *sig) {
   SDL_Rect s_bar = {0, 0, SCREEN_W, FONT_H + 2};
   SDL_SetRenderDrawColor(app->renderer, STATUSBAR_BG_R, STATUSBAR_BG_G, STATUSBAR_BG_B, 255);
   SDL_RenderFillRect(app->renderer, &s_bar);
 
   // 左側: レイヤ表示
   const char *mode_s = "";
-  if (app->input.kbd_layer == 0) mode_s = "[ABC]";
-  else if (app->input.kbd_layer == 1) mode_s = "[123]";
+  if (sig->kbd_layer == 0) mode_s = "[ABC]";
+  else if (sig->kbd_layer == 1) mode_s = "[123]";
   else mode_s = "[#&!]";
   ui_draw_text_utf8(app, STATUSBAR_LAYER_X, STATUSBAR_LAYER_Y, (SDL_Color){200,200,200,255}, mode_s);
 
@@ -159,33 +426,41 @@ static void render_status_bar(App* app) {
   const char *meta_icon  = app->ui.ui_use_nerd_icons ? "󰘳" : "META";
   const char *shift_icon  = app->ui.ui_use_nerd_icons ? "󰘶" : "SHIFT";
 
-  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,200,255,255}, ctrl_icon, app->input.mod_ctrl);
-  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,220,180,255}, alt_icon, app->input.mod_alt);
-  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){180,220,255,255}, meta_icon, app->input.mod_meta);
-  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,180,180,255}, shift_icon, app->input.mod_shift);
+  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,200,255,255}, ctrl_icon, sig->mod_ctrl);
+  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,220,180,255}, alt_icon, sig->mod_alt);
+  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){180,220,255,255}, meta_icon, sig->mod_meta);
+  x = ui_draw_mod_indicator(app, x, STATUSBAR_LAYER_Y, (SDL_Color){255,180,180,255}, shift_icon, sig->mod_shift);
 
-  if (app->input.cursor_mode) {
+  if (sig->cursor_mode) {
     const char *cursor_icon  = app->ui.ui_use_nerd_icons ? " CURSOR" : "CURSOR";
     ui_draw_text_utf8(app, STATUSBAR_CURSOR_X, STATUSBAR_LAYER_Y, (SDL_Color){200,200,200,255}, cursor_icon);
   }
 
-  if (SESSION(app)->region_mode) {
+  if (sig->search_active) {
+    // 検索語は末尾が見えるように
+    const SbSearch *q = &SESSION(app)->search;
+    const char *tail = q->query + (q->len > STATUSBAR_SEARCH_CHARS ? q->len - STATUSBAR_SEARCH_CHARS : 0);
+    char search_s[SEARCH_QUERY_MAX + 8];
+    snprintf(search_s, sizeof(search_s), "/%s%s", tail, q->failed ? " ?" : "");
+    SDL_Color col = q->failed ? (SDL_Color){255,150,150,255} : (SDL_Color){150,230,255,255};
+    ui_draw_text_utf8(app, STATUSBAR_REGION_X, STATUSBAR_LAYER_Y, col, search_s);
+  } else if (sig->region_mode) {
     const char *region_icon  = app->ui.ui_use_nerd_icons ? "󰩭 REGION" : "REGION";
     const char *selecting_icon  = app->ui.ui_use_nerd_icons ? "󰩭 REGION SEL" : "REGION_SEL";
     ui_draw_text_utf8(app, STATUSBAR_REGION_X, STATUSBAR_LAYER_Y, (SDL_Color){200,200,200,255},
-                      SESSION(app)->selecting ? selecting_icon : region_icon);
+                      sig->selecting ? selecting_icon : region_icon);
+  } else if (sig->paste_pct >= 0) {
+    char paste_s[24];
+    snprintf(paste_s, sizeof(paste_s), "PASTE %d%%", sig->paste_pct);
+    ui_draw_text_utf8(app, STATUSBAR_REGION_X, STATUSBAR_LAYER_Y, (SDL_Color){255,230,150,255}, paste_s);
   }
 
   // 右側: battery / time を「幅計測して右寄せ」
   char batt_s[16];
-  int batt_lv = (app->status_cache.cached_batt >= 0) ? app->status_cache.cached_batt : battery_get_level();
-  if (batt_lv < 0) batt_lv = 0;
-  snprintf(batt_s, sizeof(batt_s), "%d%%", batt_lv);
+  snprintf(batt_s, sizeof(batt_s), "%d%%", sig->batt);
 
-  time_t t = time(NULL);
-  struct tm *tm_now = localtime(&t);
   char time_s[10];
-  snprintf(time_s, sizeof(time_s), "%02d:%02d", tm_now->tm_hour, tm_now->tm_min);
+  snprintf(time_s, sizeof(time_s), "%02d:%02d", sig->hour, sig->minute);
 
   int batt_w = ui_text_width_utf8(app, batt_s);
   int time_w = ui_text_width_utf8(app, time_s);
@@ -199,36 +474,278 @@ static void render_status_bar(App* app) {
   ui_draw_text_utf8(app, batt_x, STATUSBAR_LAYER_Y, (SDL_Color){180,255,180,255}, batt_s);
 }
 
-static void render_terminal_area(App* app) {
-  render_draw_with_scrollback(app);
+static void render_terminal_area(App* app, int update) {
+  Session *s = SESSION(app);
+  RenderResources *rr = &app->render;
+  SDL_Rect term_rect = { 0, TERM_Y, TERM_COLS * FONT_W, TERM_ROWS * FONT_H };
+
+  if (!update && rr->term_tex && rr->term_valid) {
+    SDL_RenderCopy(app->renderer, rr->term_tex, NULL, &term_rect);
+    return;
+  }
+
+  if (!render_term_texture_ensure(app)) {
+    // レンダーターゲット非対応: ビューポートをずらして毎回全行描画
+    SDL_RenderSetViewport(app->renderer, &term_rect);
+    SDL_Rect all = { 0, 0, term_rect.w, term_rect.h };
+    SDL_SetRenderDrawColor(app->renderer, rr->def_bg.r, rr->def_bg.g, rr->def_bg.b, 255);
+    SDL_RenderFillRect(app->renderer, &all);
+    memset(rr->term_row_blink, 0, sizeof(rr->term_row_blink));
+    render_draw_with_scrollback(app);
+    app->stats.rows_drawn += TERM_ROWS;
+    render_cells_flush(app);
+    SDL_RenderSetViewport(app->renderer, NULL);
+    return;
+  }
+
+  int start = sb_virtual_start_line(app);
+  int blink_flip = rr->term_drawn_blink_on != rr->blink_on;
+
+  uint64_t ids[TERM_ROWS];
+  for (int r = 0; r < TERM_ROWS; r++) ids[r] = sb_virtual_line_id(s, start + r);
+
+  // セッション切替・パレット変更は全行。出力や L2/R2 のスクロールは描いてある行をずらして使い、
+  // 新しく見えた行だけ描く
+  int full = !rr->term_valid
+          || rr->term_drawn_sess != app->active_sess
+          || rr->term_drawn_repaint_seq != s->repaint_seq;
+  if (!full) render_term_scroll(app, render_term_shift(rr, ids));
+
+  SDL_SetRenderTarget(app->renderer, rr->term_tex);
+
+  int dirty_rows[TERM_ROWS];
+  SDL_Rect clear_rects[TERM_ROWS];
+  int ndirty = 0;
+
+  for (int r = 0; r < TERM_ROWS; r++) {
+    int vline = start + r;
+
+    int hl_from, hl_to;
+    sb_region_line_hl_range(app, vline, &hl_from, &hl_to);
+
+    int dirty = full
+             || rr->term_drawn_id[r] != ids[r]
+             || (blink_flip && rr->term_row_blink[r])
+             || rr->term_drawn_hl[r][0] != hl_from
+             || rr->term_drawn_hl[r][1] != hl_to;
+
+    int vrow = vline - s->sb_count;
+    if (!dirty && vrow >= 0 && vrow < TERM_ROWS) dirty = s->dirty_rows[vrow];
+    if (!dirty) continue;
+
+    dirty_rows[ndirty] = r;
+    clear_rects[ndirty] = (SDL_Rect){ 0, r * FONT_H, TERM_COLS * FONT_W, FONT_H };
+    ndirty++;
+
+    rr->term_drawn_id[r] = ids[r];
+    rr->term_drawn_hl[r][0] = hl_from;
+    rr->term_drawn_hl[r][1] = hl_to;
+  }
+
+  if (ndirty > 0) {
+    // 汚れた行をまとめて既定背景色でクリアし、既定色以外の背景だけを上に描く。
+    // グリフはセル内にクリップされるので、行単位の描き直しで隣の行を汚さない
+    SDL_SetRenderDrawColor(app->renderer, rr->def_bg.r, rr->def_bg.g, rr->def_bg.b, 255);
+    SDL_RenderFillRects(app->renderer, clear_rects, ndirty);
+    app->stats.fill_calls++;
+    app->stats.fill_rects += (Uint32)ndirty;
+
+    for (int i = 0; i < ndirty; i++) {
+      int r = dirty_rows[i];
+      rr->term_row_blink[r] = 0;   // 描きながら付け直す
+      render_draw_term_row(app, r, start + r, rr->term_drawn_hl[r][0], rr->term_drawn_hl[r][1]);
+    }
+    app->stats.rows_drawn += (Uint32)ndirty;
+  }
+
+  render_cells_flush(app);
+  render_target_reset(app);
+
+  memset(s->dirty_rows, 0, sizeof(s->dirty_rows));
+  rr->term_valid = 1;
+  rr->term_drawn_sess = app->active_sess;
+  rr->term_drawn_repaint_seq = s->repaint_seq;
+  rr->term_drawn_blink_on = rr->blink_on;
+
+  SDL_RenderCopy(app->renderer, rr->term_tex, NULL, &term_rect);
+}
+
+static int render_term_texture_ensure(App* app) {
+  RenderResources *rr = &app->render;
+  if (rr->term_tex) return 1;
+  if (rr->targets_failed) return 0;
+
+  if (SDL_RenderTargetSupported(app->renderer)) {
+    rr->term_tex = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                     TERM_COLS * FONT_W, TERM_ROWS * FONT_H);
+  }
+  if (!rr->term_tex) {
+    fprintf(stderr, "Terminal texture unavailable, full redraw fallback: %s\n", SDL_GetError());
+    rr->targets_failed = 1;
+    return 0;
+  }
+
+  SDL_SetTextureBlendMode(rr->term_tex, SDL_BLENDMODE_NONE);
+  rr->term_valid = 0;
+  return 1;
+}
+
+// 今の先頭行から順に、描いてある行に同じ内容があればその行の差（+ なら内容が上へ動いた）
+static int render_term_shift(const RenderResources *rr, const uint64_t *ids) {
+  for (int r = 0; r < TERM_ROWS; r++) {
+    if (!ids[r]) continue;
+    for (int j = 0; j < TERM_ROWS; j++) {
+      if (rr->term_drawn_id[j] == ids[r]) return j - r;
+    }
+  }
+  return 0;
+}
+
+// 端末テクスチャを行単位でずらす。同じテクスチャには写せないので裏へ写して入れ替える。
+// 空いた行は未描画にしておくので、呼び出し側の判定で描かれる
+static void render_term_scroll(App* app, int shift) {
+  RenderResources *rr = &app->render;
+  if (shift == 0 || shift >= TERM_ROWS || shift <= -TERM_ROWS) return;
+
+  if (!rr->term_tex_back) {
+    rr->term_tex_back = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                          TERM_COLS * FONT_W, TERM_ROWS * FONT_H);
+    if (!rr->term_tex_back) return;   // ずらせなければ全行描き直すだけ
+    SDL_SetTextureBlendMode(rr->term_tex_back, SDL_BLENDMODE_NONE);
+  }
+
+  int n = TERM_ROWS - abs(shift);
+  int src_r = shift > 0 ? shift : 0;
+  int dst_r = shift > 0 ? 0 : -shift;
+  SDL_Rect src = { 0, src_r * FONT_H, TERM_COLS * FONT_W, n * FONT_H };
+  SDL_Rect dst = { 0, dst_r * FONT_H, TERM_COLS * FONT_W, n * FONT_H };
+
+  SDL_SetRenderTarget(app->renderer, rr->term_tex_back);
+  SDL_RenderCopy(app->renderer, rr->term_tex, &src, &dst);
+
+  SDL_Texture *tmp = rr->term_tex;
+  rr->term_tex = rr->term_tex_back;
+  rr->term_tex_back = tmp;
+
+  memmove(&rr->term_drawn_id[dst_r], &rr->term_drawn_id[src_r], (size_t)n * sizeof(rr->term_drawn_id[0]));
+  memmove(&rr->term_drawn_hl[dst_r], &rr->term_drawn_hl[src_r], (size_t)n * sizeof(rr->term_drawn_hl[0]));
+  memmove(&rr->term_row_blink[dst_r], &rr->term_row_blink[src_r], (size_t)n);
+
+  int gap = shift > 0 ? n : 0;
+  for (int r = gap; r < gap + TERM_ROWS - n; r++) {
+    rr->term_drawn_id[r] = 0;
+    rr->term_row_blink[r] = 0;
+  }
+  app->stats.rows_blitted += (Uint32)n;
+}
+
+// レンダーターゲット用テクスチャを用意する。-1: 非対応 / 0: 既存 / 1: 新規作成（要描画）
+static int render_layer_ensure(App* app, SDL_Texture **tex, int w, int h) {
+  if (*tex) return 0;
+  if (app->render.targets_failed || !SDL_RenderTargetSupported(app->renderer)) return -1;
+
+  *tex = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+  if (!*tex) {
+    fprintf(stderr, "Layer texture unavailable: %s\n", SDL_GetError());
+    app->render.targets_failed = 1;
+    return -1;
+  }
+  SDL_SetTextureBlendMode(*tex, SDL_BLENDMODE_NONE);
+  return 1;
+}
+
+static void render_layer_begin(App* app, SDL_Texture *tex) {
+  SDL_SetRenderTarget(app->renderer, tex);
+  SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255);
+  SDL_RenderClear(app->renderer);
 }
 
 static void render_menu_overlay_if_active(App* app) {
-  if (app->ui.menu_active) {
-    ui_draw_session_menu_overlay(app);
+  if (!app->ui.menu_active) return;
+
+  RenderResources *rr = &app->render;
+  SDL_Rect dst = { MENU_OVERLAY_MARGIN_X, MENU_OVERLAY_MARGIN_Y,
+                   SCREEN_W - MENU_OVERLAY_WIDTH_REDUCE, SCREEN_H - MENU_OVERLAY_HEIGHT_REDUCE };
+
+  int st = render_layer_ensure(app, &rr->menu_tex, dst.w, dst.h);
+  if (st < 0) {
+    ui_draw_session_menu_overlay(app, dst.x, dst.y);
+    return;
+  }
+
+  MenuLayerSig sig;
+  render_menu_sig(app, &sig);
+
+  if (st > 0 || rr->menu_dirty || memcmp(&sig, &rr->menu_sig, sizeof(sig)) != 0) {
+    render_layer_begin(app, rr->menu_tex);
+    ui_draw_session_menu_overlay(app, 0, 0);
+    render_target_reset(app);
+    rr->menu_sig = sig;
+    rr->menu_dirty = 0;
+  }
+
+  SDL_RenderCopy(app->renderer, rr->menu_tex, NULL, &dst);
+}
+
+static void render_menu_sig(App* app, MenuLayerSig *sig) {
+  memset(sig, 0, sizeof(*sig));
+  sig->menu_sel = app->ui.menu_sel;
+  sig->active_sess = app->active_sess;
+  for (int i = 0; i < MAX_SESSIONS; i++) {
+    sig->used[i] = app->sessions[i].used ? 1 : 0;
+    sig->locked[i] = (app->sessions[i].used && session_is_locked(&app->sessions[i])) ? 1 : 0;
   }
 }
 
+// キーボードはレイヤごとに選択なしの状態をキャッシュし、選択キーだけ毎回重ねる
 static void render_keyboard(App* app) {
-  int sep_y = (TERM_ROWS * FONT_H) + TERM_Y + KEYBOARD_SEP_OFFSET_Y;
+  RenderResources *rr = &app->render;
+  int layer = app->input.kbd_layer;
+  int top = (TERM_ROWS * FONT_H) + TERM_Y + KEYBOARD_SEP_OFFSET_Y;
+  SDL_Rect dst = { 0, top, SCREEN_W, SCREEN_H - top };
+
+  int st = render_layer_ensure(app, &rr->kbd_tex[layer], dst.w, dst.h);
+  if (st < 0) {
+    render_keyboard_keys(app, layer, 0, 1);
+    return;
+  }
+
+  if (st > 0 || rr->kbd_dirty[layer]) {
+    render_layer_begin(app, rr->kbd_tex[layer]);
+    render_keyboard_keys(app, layer, top, 0);
+    render_target_reset(app);
+    rr->kbd_dirty[layer] = 0;
+  }
+
+  SDL_RenderCopy(app->renderer, rr->kbd_tex[layer], NULL, &dst);
+  render_keyboard_key(app, layer, app->input.kbd_sel_row, app->input.kbd_sel_col, 0, 1);
+}
+
+// oy: 描画先の原点 y（テクスチャへ描く時はキーボード上端）
+static void render_keyboard_keys(App* app, int layer, int oy, int draw_selection) {
+  int sep_y = (TERM_ROWS * FONT_H) + TERM_Y + KEYBOARD_SEP_OFFSET_Y - oy;
   SDL_SetRenderDrawColor(app->renderer, KEYBOARD_SEP_COLOR_R, KEYBOARD_SEP_COLOR_G, KEYBOARD_SEP_COLOR_B, 255);
   SDL_RenderDrawLine(app->renderer, 0, sep_y, SCREEN_W, sep_y);
 
-  int key_w = SCREEN_W / KEY_COLS;
-  int key_h = FONT_H + KEYBOARD_KEY_HEIGHT_EXTRA;
-  sep_y -= KEYBOARD_SEP_ADJUST;
-
   for (int r = 0; r < KEY_ROWS; r++) {
     for (int c = 0; c < KEY_COLS; c++) {
-      int x0 = c * key_w;
-      int y0 = sep_y + 8 + (r * key_h);
-      int selected = (r == app->input.kbd_sel_row && c == app->input.kbd_sel_col);
-      const KeyDefinition *k = &app->ui.layers[app->input.kbd_layer][r][c];
-      ui_draw_key_button(app, x0 + KEYBOARD_KEY_MARGIN, y0, key_w - 4, FONT_H + 6, k->label, selected);
+      int selected = draw_selection && (r == app->input.kbd_sel_row && c == app->input.kbd_sel_col);
+      render_keyboard_key(app, layer, r, c, oy, selected);
     }
   }
 }
 
+static void render_keyboard_key(App* app, int layer, int r, int c, int oy, int selected) {
+  int sep_y = (TERM_ROWS * FONT_H) + TERM_Y + KEYBOARD_SEP_OFFSET_Y - KEYBOARD_SEP_ADJUST - oy;
+  int key_w = SCREEN_W / KEY_COLS;
+  int key_h = FONT_H + KEYBOARD_KEY_HEIGHT_EXTRA;
+
+  int x0 = c * key_w;
+  int y0 = sep_y + 8 + (r * key_h);
+  const KeyDefinition *k = &app->ui.layers[layer][r][c];
+  ui_draw_key_button(app, x0 + KEYBOARD_KEY_MARGIN, y0, key_w - 4, FONT_H + 6, k->label, selected);
+}
+
 static void render_cursor_or_region(App* app) {
   if (SESSION(app)->region_mode) {
     int start = sb_virtual_start_line(app);
@@ -249,6 +766,8 @@ static void render_cursor_or_region(App* app) {
       SDL_Rect cr = { cpos.col * FONT_W, TERM_Y + cpos.row * FONT_H, FONT_W, FONT_H };
       SDL_SetRenderDrawColor(app->renderer, 255, 255, 255, 255);
       SDL_RenderFillRect(app->renderer, &cr);
+      app->render.frame_cursor = cr;
+      app->render.frame_cursor_on = 1;
     }
   }
 }
@@ -1,11 +1,14 @@
 #pragma once
 #include "app.h"
 
-void render_frame(App *app);
+void render_frame(App *app, int what);
+void render_invalidate(App *app);
+void render_shutdown(App *app);
 void render_draw_scrollback_line(App* app, int logical_i, int screen_r, int hl_from, int hl_to);
 void render_draw_vterm_line(App* app, int vterm_row, int screen_r, int hl_from, int hl_to);
 void render_draw_with_scrollback(App* app);
 void render_draw_cell_rgb(App* app,
 						  int x, int y, uint32_t c,
-						  SDL_Color fg_c, SDL_Color bg_c,
+						  SDL_Color fg_c, SDL_Color bg_c, uint8_t attrs,
 						  int highlight, int wide);
+void render_cells_flush(App *app);
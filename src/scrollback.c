@@ -1,4 +1,34 @@
 #include "scrollback.h"
+#include "search.h"
+#include "term.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static unsigned sb_color_quantize(uint32_t rgb);
+static void sb_colors_sweep(Session *s);
+static void sb_colors_mark(uint8_t *used, const ScrollbackCell *cells, size_t n);
+static void sb_block_free(SbColdBlock *blk);
+static int sb_hot_index(const Session *s, int hot_i);
+static int sb_hot_grow(Session *s);
+static int sb_cold_spill(Session *s);
+static void sb_cold_evict_oldest(Session *s);
+static void sb_drop_front(Session *s, int n);
+static int sb_spill_append(Session *s, const SbColdBlock *blk);
+static int sb_spill_write(Session *s, const void *data, size_t len, uint64_t off);
+static void sb_spill_close(Session *s);
+static const SbColdBlock *sb_block_at(Session *s, int i);
+static const ScrollbackCell *sb_block_decoded(Session *s, const SbColdBlock *blk);
+static int sb_block_decode(Session *s, const SbColdBlock *blk, ScrollbackCell *out);
+static uint64_t sb_plane_value(const ScrollbackCell *const *rows, int i, int plane);
+static uint8_t *sb_rle_encode(uint8_t *p, const ScrollbackCell *const *rows, int plane);
+static int sb_rle_decode(const uint8_t **pp, const uint8_t *end, ScrollbackCell *out, int plane);
+static size_t sb_put_varint(uint8_t *p, uint64_t v);
+static int sb_get_varint(const uint8_t **pp, const uint8_t *end, uint64_t *v);
 
 int sb_clampi(int v, int lo, int hi) {
   if (v < lo) return lo;
@@ -43,6 +73,13 @@ void sb_region_line_hl_range(App* app, int vline, int *from, int *to) {
   *from = 1;
   *to = 0;
 
+  // 検索中は一致箇所だけ
+  const SbSearch *q = &SESSION(app)->search;
+  if (q->active) {
+    if (q->match_line == vline) { *from = q->match_col; *to = q->match_end_col; }
+    return;
+  }
+
   if (!SESSION(app)->region_mode || !SESSION(app)->selecting) return;
 
   int l1 = SESSION(app)->sel_line;
@@ -67,14 +104,6 @@ void sb_region_line_hl_range(App* app, int vline, int *from, int *to) {
   *to = TERM_COLS - 1;
 }
 
-int sb_phys_index(App* app, int i) {
-  int sb_head = SESSION(app)->sb_head;
-  int sb_count = SESSION(app)->sb_count;
-  int base = sb_head - sb_count;
-  while (base < 0) base += SCROLLBACK_LINES;
-  return (base + i) % SCROLLBACK_LINES;
-}
-
 int sb_virtual_start_line(App* app) {
   if (SESSION(app)->view_offset_lines < 0) SESSION(app)->view_offset_lines = 0;
   if (SESSION(app)->view_offset_lines > SESSION(app)->sb_count) SESSION(app)->view_offset_lines = SESSION(app)->sb_count;
@@ -84,3 +113,633 @@ int sb_virtual_start_line(App* app) {
 int sb_virtual_total_lines(App* app) {
   return SESSION(app)->sb_count + TERM_ROWS;
 }
+
+// 論理行の内容ID。scrollback の行は捨てた行数からの通し番号なので push では変わらない
+uint64_t sb_virtual_line_id(const Session *s, int vline) {
+  if (vline < s->sb_count) return SB_LINE_ID_SCROLLBACK | (s->sb_dropped + (uint64_t)vline);
+  int vrow = vline - s->sb_count;
+  return vrow < TERM_ROWS ? s->screen_row_id[vrow] : 0;
+}
+
+// 確保は最初の SB_GROW_LINES 行分だけ。上限が hot に収まらない分は cold に回す
+void sb_store_init(Session *s, int max_lines) {
+  s->sb_max = max_lines > 0 ? max_lines : 0;
+  s->sb_hot_max = s->sb_max < SB_HOT_LINES_MAX ? s->sb_max : SB_HOT_LINES_MAX;
+  sb_hot_grow(s);
+  sb_colors_reset(&s->sb_colors);
+}
+
+void sb_store_free(Session *s) {
+  sb_store_clear(s);
+  free(s->sb_buf);
+  free(s->sb_cont);
+  free(s->sb_cold);
+  sb_spill_close(s);
+  for (int k = 0; k < SB_DECODE_CACHE; k++) free(s->sb_decoded[k].cells);
+  s->sb_buf = NULL;
+  s->sb_cont = NULL;
+  s->sb_cold = NULL;
+  s->sb_cap = 0;
+  s->sb_cold_cap = 0;
+  memset(s->sb_decoded, 0, sizeof(s->sb_decoded));
+  sb_colors_reset(&s->sb_colors);
+}
+
+// 確保済みのバッファとスピルファイルは残し、中身だけ捨てる
+void sb_store_clear(Session *s) {
+  for (int b = 0; b < s->sb_cold_count; b++) sb_block_free(&s->sb_cold[b]);
+  for (int b = 0; b < s->sb_spill_count; b++) sb_block_free(&s->sb_spill[b]);
+  s->sb_cold_count = 0;
+  s->sb_cold_bytes = 0;
+  s->sb_spill_count = 0;
+  s->sb_spill_size = 0;
+  if (s->sb_spill_fd >= 0 && ftruncate(s->sb_spill_fd, 0) != 0) sb_spill_close(s);
+  for (int k = 0; k < SB_DECODE_CACHE; k++) s->sb_decoded[k].seq = 0;
+
+  s->sb_dropped += (uint64_t)s->sb_count;
+  s->sb_head = 0;
+  s->sb_hot_count = 0;
+  s->sb_count = 0;
+  if (s->sb_cont) memset(s->sb_cont, 0, (size_t)s->sb_cap);
+  // 色の表は画面（VTERM_BACKEND=state の grid とペン）も同じ ID で引いているので残す
+  s->search.match_line = -1;
+}
+
+// 1行ぶん場所を空けて書き込み先を返す（解析スレッドから lock 下で呼ばれる）
+ScrollbackCell *sb_store_push(Session *s, int continuation) {
+  sb_colors_maybe_sweep(s);
+
+  // 満杯で最古の行が先頭にある時に確保を伸ばす（伸ばせなければ今の容量で回す）
+  if (s->sb_hot_count == s->sb_cap && s->sb_head == 0 && s->sb_cap < s->sb_hot_max
+      && sb_hot_grow(s) == 0) {
+    s->sb_head = s->sb_hot_count;
+  }
+  if (s->sb_cap == 0) return NULL;
+
+  if (s->sb_hot_count == s->sb_cap) {
+    int spilled = 0;
+    if (s->sb_hot_max < s->sb_max && s->sb_hot_count >= SB_BLOCK_LINES) {
+      // 圧縮できない（メモリ不足）なら古い cold から手放してやり直す
+      while (!(spilled = (sb_cold_spill(s) == 0)) && s->sb_cold_count > 0) sb_cold_evict_oldest(s);
+    }
+    if (!spilled) {
+      // 最古の hot 行を上書きする。それより古いスピル済みの行も残せないので一緒に捨てる
+      int dropped = s->sb_spill_count * SB_BLOCK_LINES + 1;
+      if (s->sb_spill_count > 0) sb_spill_close(s);
+      s->sb_hot_count--;
+      sb_drop_front(s, dropped);
+    }
+  }
+
+  ScrollbackCell *dst = &s->sb_buf[(size_t)s->sb_head * TERM_COLS];
+  s->sb_cont[s->sb_head] = continuation ? 1 : 0;
+  s->sb_head = (s->sb_head + 1) % s->sb_cap;
+  s->sb_hot_count++;
+  s->sb_count++;
+
+  // 上限は RAM に持つ行数（スピル済みの行は数えない）
+  while (s->sb_count - s->sb_spill_count * SB_BLOCK_LINES > s->sb_max && s->sb_cold_count > 0) {
+    sb_cold_evict_oldest(s);
+  }
+  return dst;
+}
+
+// 論理行 i（0 が最古）のセル。古い順に スピル → cold → hot と並ぶ。
+// スピル・cold の行は展開キャッシュを指す（次の sb_line で無効になりうる）
+const ScrollbackCell *sb_line(Session *s, int i) {
+  if (i < 0 || i >= s->sb_count) return NULL;
+
+  const SbColdBlock *blk = sb_block_at(s, i);
+  if (!blk) {
+    int hot_i = i - (s->sb_spill_count + s->sb_cold_count) * SB_BLOCK_LINES;
+    return &s->sb_buf[(size_t)sb_hot_index(s, hot_i) * TERM_COLS];
+  }
+
+  const ScrollbackCell *cells = sb_block_decoded(s, blk);
+  if (!cells) return NULL;
+  return &cells[(size_t)(i % SB_BLOCK_LINES) * TERM_COLS];
+}
+
+int sb_line_cont(Session *s, int i) {
+  if (i < 0 || i >= s->sb_count) return 0;
+
+  const SbColdBlock *blk = sb_block_at(s, i);
+  if (!blk) {
+    int hot_i = i - (s->sb_spill_count + s->sb_cold_count) * SB_BLOCK_LINES;
+    return s->sb_cont[sb_hot_index(s, hot_i)] ? 1 : 0;
+  }
+
+  int l = i % SB_BLOCK_LINES;
+  return (blk->cont[l / 8] >> (l % 8)) & 1;
+}
+
+// スピル・cold のブロック数（論理行 0 から SB_BLOCK_LINES 行ずつ）
+int sb_block_count(const Session *s) {
+  return s->sb_spill_count + s->sb_cold_count;
+}
+
+// 0 ならブロックは hashes の trigram を全部は含まない（検索で読み飛ばせる）
+int sb_block_maybe_contains(Session *s, int block, const uint32_t *hashes, int n) {
+  const SbColdBlock *blk = sb_block_at(s, block * SB_BLOCK_LINES);
+  if (!blk || blk->bloom_bytes == 0) return 1;
+  if (blk->bloom) return search_bloom_test(blk->bloom, blk->bloom_bytes, hashes, n);
+  if (blk->data || s->sb_spill_fd < 0) return 1;
+
+  uint8_t bloom[SB_BLOOM_MAX_BYTES];
+  ssize_t r = pread(s->sb_spill_fd, bloom, blk->bloom_bytes, (off_t)(blk->off + blk->size));
+  if (r != (ssize_t)blk->bloom_bytes) return 1;
+  return search_bloom_test(bloom, blk->bloom_bytes, hashes, n);
+}
+
+void sb_colors_reset(SbColorTable *t) {
+  memset(t->hash, 0, sizeof(t->hash));
+  t->count = 0;
+  t->free_count = 0;
+  t->misses = 0;
+}
+
+// 表が埋まって丸めが続いていれば、もう誰も使っていない ID を回収する。
+// 詰めかけの行やペンの色を取りこぼさないよう、色を引く前（push の入口・SGR の処理前）にだけ呼ぶ
+void sb_colors_maybe_sweep(Session *s) {
+  if (s->sb_colors.misses >= SB_COLOR_SWEEP_MISSES) sb_colors_sweep(s);
+}
+
+// libvterm の1行を 8 バイトのセルに一度に詰める（解析スレッドから lock 下で呼ばれる）。
+// 属性と色が前のセルと同じ間は上位ビットを使い回すので、既定色だけのログ行では色を一度も引かない
+void sb_line_pack(Session *s, ScrollbackCell *dst, const VTermScreenCell *cells, int cols) {
+  if (cols > TERM_COLS) cols = TERM_COLS;
+
+  const VTermScreenCell *prev = NULL;
+  ScrollbackCell style = 0;
+  for (int c = 0; c < cols; c++) {
+    const VTermScreenCell *cell = &cells[c];
+    if (!prev || memcmp(&cell->attrs, &prev->attrs, sizeof(cell->attrs)) != 0
+        || memcmp(&cell->fg, &prev->fg, sizeof(cell->fg)) != 0
+        || memcmp(&cell->bg, &prev->bg, sizeof(cell->bg)) != 0) {
+      style = ((ScrollbackCell)term_cell_attrs(cell) << SB_CELL_ATTR_SHIFT)
+            | ((ScrollbackCell)sb_color_id(&s->sb_colors, cell->fg) << SB_CELL_FG_SHIFT)
+            | ((ScrollbackCell)sb_color_id(&s->sb_colors, cell->bg) << SB_CELL_BG_SHIFT);
+      prev = cell;
+    }
+
+    uint32_t cp = 0;
+    int width = cell->width;
+    if (width < 0 || width > 2) width = 1;
+    if (width > 0) {
+      cp = cell->chars[0] ? cell->chars[0] : ' ';
+      if (cp > 0x1FFFFF) cp = 0xFFFD;
+    }
+    dst[c] = (ScrollbackCell)cp | ((ScrollbackCell)width << SB_CELL_WIDTH_SHIFT) | style;
+  }
+
+  ScrollbackCell blank = sb_cell_blank();
+  for (int c = cols < 0 ? 0 : cols; c < TERM_COLS; c++) dst[c] = blank;
+}
+
+// 行末の埋め草（既定色の空白）
+ScrollbackCell sb_cell_blank(void) {
+  return (ScrollbackCell)' '
+    | ((ScrollbackCell)1 << SB_CELL_WIDTH_SHIFT)
+    | ((ScrollbackCell)SB_COLOR_DEFAULT_FG << SB_CELL_FG_SHIFT)
+    | ((ScrollbackCell)SB_COLOR_DEFAULT_BG << SB_CELL_BG_SHIFT);
+}
+
+// パレット色は描画時に引くので、既定色やパレットの変更は過去の行にも反映される
+SDL_Color sb_color_to_sdl(App *app, Session *s, unsigned id) {
+  if (id == SB_COLOR_DEFAULT_FG) return app->render.def_fg;
+  if (id == SB_COLOR_DEFAULT_BG) return app->render.def_bg;
+  if (id < SB_COLOR_RGB_BASE) return s->palette[id - SB_COLOR_PALETTE_BASE];
+  uint32_t rgb = s->sb_colors.rgb[id];
+  return (SDL_Color){ (uint8_t)(rgb >> 16), (uint8_t)(rgb >> 8), (uint8_t)rgb, 255 };
+}
+
+// 色を色IDへ。RGB は表に登録して重複を除く
+unsigned sb_color_id(SbColorTable *t, VTermColor c) {
+  if (VTERM_COLOR_IS_DEFAULT_FG(&c)) return SB_COLOR_DEFAULT_FG;
+  if (VTERM_COLOR_IS_DEFAULT_BG(&c)) return SB_COLOR_DEFAULT_BG;
+  if (VTERM_COLOR_IS_INDEXED(&c)) return SB_COLOR_PALETTE_BASE + c.indexed.idx;
+
+  uint32_t rgb = ((uint32_t)c.rgb.red << 16) | ((uint32_t)c.rgb.green << 8) | c.rgb.blue;
+  uint32_t h = (rgb * 2654435761u) & (SB_COLOR_HASH_SIZE - 1);
+  for (;;) {
+    uint16_t id = t->hash[h];
+    if (id == 0) break;
+    if (t->rgb[id] == rgb) return id;
+    h = (h + 1) & (SB_COLOR_HASH_SIZE - 1);
+  }
+
+  // 回収済みの ID から使い、それも尽きたら登録せずに最寄りのパレット色へ
+  unsigned id;
+  if (t->free_count > 0) {
+    id = t->free_ids[--t->free_count];
+  } else if (SB_COLOR_RGB_BASE + t->count < SB_COLOR_IDS) {
+    id = SB_COLOR_RGB_BASE + t->count++;
+  } else {
+    t->misses++;
+    t->fallbacks++;
+    return sb_color_quantize(rgb);
+  }
+  t->rgb[id] = rgb;
+  t->hash[h] = (uint16_t)id;
+  return id;
+}
+
+// xterm 256色の 6x6x6 キューブとグレースケールのうち近い方
+static unsigned sb_color_quantize(uint32_t rgb) {
+  static const int lv[6] = { 0, 95, 135, 175, 215, 255 };
+  int r = (rgb >> 16) & 0xFF, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+
+  int ci[3], ch[3] = { r, g, b };
+  for (int k = 0; k < 3; k++) {
+    int v = ch[k];
+    ci[k] = v < 48 ? 0 : v < 115 ? 1 : (v - 35) / 40;
+  }
+  int cr = lv[ci[0]], cg = lv[ci[1]], cb = lv[ci[2]];
+  int cube_d = (r - cr) * (r - cr) + (g - cg) * (g - cg) + (b - cb) * (b - cb);
+
+  int avg = (r + g + b) / 3;
+  int gi = avg > 238 ? 23 : avg < 8 ? 0 : (avg - 8) / 10;
+  int gv = 8 + gi * 10;
+  int gray_d = (r - gv) * (r - gv) + (g - gv) * (g - gv) + (b - gv) * (b - gv);
+
+  unsigned idx = (gray_d < cube_d) ? 232u + gi : 16u + 36 * ci[0] + 6 * ci[1] + ci[2];
+  return SB_COLOR_PALETTE_BASE + idx;
+}
+
+// 使われている RGB の ID に印を付けて、残りを空きに戻す。参照元は hot の行・cold/スピルの一覧・
+// （VTERM_BACKEND=state なら）画面とペン。VTermScreen 版の画面は色を VTermColor で持つので参照しない
+static void sb_colors_sweep(Session *s) {
+  SbColorTable *t = &s->sb_colors;
+  uint8_t used[SB_COLOR_IDS] = {0};
+
+  for (int l = 0; l < s->sb_hot_count; l++) {
+    sb_colors_mark(used, &s->sb_buf[(size_t)sb_hot_index(s, l) * TERM_COLS], TERM_COLS);
+  }
+  for (int b = 0; b < s->sb_cold_count + s->sb_spill_count; b++) {
+    const SbColdBlock *blk = b < s->sb_spill_count ? &s->sb_spill[b] : &s->sb_cold[b - s->sb_spill_count];
+    for (int k = 0; k < blk->rgb_count; k++) used[blk->rgb_ids[k]] = 1;
+  }
+#ifdef GKD_VTERM_STATE_BACKEND
+  sb_colors_mark(used, &s->grid[0][0][0], sizeof(s->grid) / sizeof(ScrollbackCell));
+  sb_colors_mark(used, &s->grid_pen, 1);
+#endif
+
+  // 生きている色だけでハッシュを組み直す（ID は変えない）
+  memset(t->hash, 0, sizeof(t->hash));
+  t->free_count = 0;
+  for (int id = SB_COLOR_RGB_BASE; id < SB_COLOR_RGB_BASE + t->count; id++) {
+    if (!used[id]) {
+      t->free_ids[t->free_count++] = (uint16_t)id;
+      continue;
+    }
+    uint32_t h = (t->rgb[id] * 2654435761u) & (SB_COLOR_HASH_SIZE - 1);
+    while (t->hash[h]) h = (h + 1) & (SB_COLOR_HASH_SIZE - 1);
+    t->hash[h] = (uint16_t)id;
+  }
+  t->misses = 0;
+}
+
+static void sb_colors_mark(uint8_t *used, const ScrollbackCell *cells, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    used[sb_cell_fg(cells[i])] = 1;
+    used[sb_cell_bg(cells[i])] = 1;
+  }
+}
+
+static void sb_block_free(SbColdBlock *blk) {
+  free(blk->data);
+  free(blk->bloom);
+  free(blk->rgb_ids);
+  blk->data = NULL;
+  blk->bloom = NULL;
+  blk->rgb_ids = NULL;
+}
+
+static int sb_hot_index(const Session *s, int hot_i) {
+  int base = s->sb_head - s->sb_hot_count;
+  while (base < 0) base += s->sb_cap;
+  return (base + hot_i) % s->sb_cap;
+}
+
+// 最古の行が物理 0 行目にある時だけ呼ぶので、末尾に足しても行の並びは変わらない
+static int sb_hot_grow(Session *s) {
+  int cap = s->sb_cap + SB_GROW_LINES;
+  if (cap > s->sb_hot_max) cap = s->sb_hot_max;
+  if (cap <= s->sb_cap) return -1;
+
+  ScrollbackCell *buf = realloc(s->sb_buf, (size_t)cap * TERM_COLS * sizeof(ScrollbackCell));
+  if (!buf) return -1;
+  s->sb_buf = buf;
+
+  uint8_t *cont = realloc(s->sb_cont, (size_t)cap);
+  if (!cont) return -1;
+  memset(cont + s->sb_cap, 0, (size_t)(cap - s->sb_cap));
+  s->sb_cont = cont;
+
+  s->sb_cap = cap;
+  return 0;
+}
+
+// hot の古い SB_BLOCK_LINES 行を圧縮して cold の末尾に移す
+static int sb_cold_spill(Session *s) {
+  if (s->sb_cold_count == s->sb_cold_cap) {
+    int cap = s->sb_cold_cap ? s->sb_cold_cap * 2 : 64;
+    SbColdBlock *cold = realloc(s->sb_cold, (size_t)cap * sizeof(SbColdBlock));
+    if (!cold) return -1;
+    s->sb_cold = cold;
+    s->sb_cold_cap = cap;
+  }
+
+  const ScrollbackCell *rows[SB_BLOCK_LINES];
+  SbColdBlock blk = {0};
+  for (int l = 0; l < SB_BLOCK_LINES; l++) {
+    int p = sb_hot_index(s, l);
+    rows[l] = &s->sb_buf[(size_t)p * TERM_COLS];
+    if (s->sb_cont[p]) blk.cont[l / 8] |= (uint8_t)(1u << (l % 8));
+  }
+
+  // 最悪でもセルあたり コードポイント面 4 + 残りの面 8 + 連長の見出し分
+  uint8_t *tmp = malloc((size_t)SB_BLOCK_LINES * TERM_COLS * 16);
+  if (!tmp) return -1;
+  uint8_t *end = sb_rle_encode(tmp, rows, 0);
+  end = sb_rle_encode(end, rows, 1);
+
+  blk.size = (uint32_t)(end - tmp);
+  blk.data = malloc(blk.size);
+  if (!blk.data) {
+    free(tmp);
+    return -1;
+  }
+  memcpy(blk.data, tmp, blk.size);
+  free(tmp);
+  blk.seq = ++s->sb_cold_seq;
+
+  // 色IDの回収で参照を数えるための一覧（作れなければ圧縮自体をやめる）
+  uint8_t used[SB_COLOR_IDS] = {0};
+  for (int l = 0; l < SB_BLOCK_LINES; l++) sb_colors_mark(used, rows[l], TERM_COLS);
+  for (int id = SB_COLOR_RGB_BASE; id < SB_COLOR_IDS; id++) blk.rgb_count += used[id];
+  if (blk.rgb_count > 0) {
+    blk.rgb_ids = malloc((size_t)blk.rgb_count * sizeof(uint16_t));
+    if (!blk.rgb_ids) {
+      free(blk.data);
+      return -1;
+    }
+    int k = 0;
+    for (int id = SB_COLOR_RGB_BASE; id < SB_COLOR_IDS; id++) {
+      if (used[id]) blk.rgb_ids[k++] = (uint16_t)id;
+    }
+  }
+
+  // 検索で読み飛ばすための要約（確保できなければ要約なし＝常に展開して調べる）
+  blk.bloom = search_bloom_build(rows, SB_BLOCK_LINES, &blk.bloom_bytes);
+
+  s->sb_cold[s->sb_cold_count++] = blk;
+  s->sb_cold_bytes += blk.size + blk.bloom_bytes;
+  s->sb_hot_count -= SB_BLOCK_LINES;
+  return 0;
+}
+
+// RAM の上限を超えた最古の cold ブロックをスピルファイルへ移す（無効・失敗なら捨てる）
+static void sb_cold_evict_oldest(Session *s) {
+  SbColdBlock *blk = &s->sb_cold[0];
+  int spilled = s->app->cfg.scrollback_spill && sb_spill_append(s, blk) == 0;
+
+  s->sb_cold_bytes -= blk->size + blk->bloom_bytes;
+  free(blk->data);
+  free(blk->bloom);
+  if (!spilled) free(blk->rgb_ids);   // スピルしたら索引の方が引き継ぐ
+  s->sb_cold_count--;
+  memmove(&s->sb_cold[0], &s->sb_cold[1], (size_t)s->sb_cold_count * sizeof(SbColdBlock));
+  if (spilled) return;
+
+  // スピル済みの行があるなら、それより新しい行だけ捨てるわけにはいかないので一緒に捨てる
+  int dropped = (s->sb_spill_count + 1) * SB_BLOCK_LINES;
+  sb_spill_close(s);
+  sb_drop_front(s, dropped);
+}
+
+// 最古の n 行が消えた後始末。論理行番号が詰まるので範囲選択・検索の一致もずらす
+static void sb_drop_front(Session *s, int n) {
+  s->sb_count -= n;
+  s->sb_dropped += (uint64_t)n;
+
+  s->reg_line = s->reg_line > n ? s->reg_line - n : 0;
+  s->sel_line = s->sel_line > n ? s->sel_line - n : 0;
+  if (s->search.match_line >= 0) {
+    s->search.match_line = s->search.match_line >= n ? s->search.match_line - n : -1;
+  }
+}
+
+// スピルファイルは開いた直後に unlink するので、セッションが終われば消える
+static int sb_spill_append(Session *s, const SbColdBlock *blk) {
+  if (s->sb_spill_fd < 0) {
+    const AppConfig *cfg = &s->app->cfg;
+    const char *dir = cfg->scrollback_spill_dir[0] ? cfg->scrollback_spill_dir : cfg->config_dir;
+    char path[600];
+    snprintf(path, sizeof(path), "%s/scrollback-XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+      fprintf(stderr, "scrollback: spill file in %s: %s\n", dir, strerror(errno));
+      return -1;
+    }
+    unlink(path);
+    s->sb_spill_fd = fd;
+    s->sb_spill_size = 0;
+    s->sb_spill_count = 0;
+  }
+
+  if (s->sb_spill_count == s->sb_spill_cap) {
+    int cap = s->sb_spill_cap ? s->sb_spill_cap * 2 : 256;
+    SbColdBlock *idx = realloc(s->sb_spill, (size_t)cap * sizeof(SbColdBlock));
+    if (!idx) return -1;
+    s->sb_spill = idx;
+    s->sb_spill_cap = cap;
+  }
+
+  // 検索の要約は data の直後に置く（無ければ bloom_bytes = 0 のまま「含むかもしれない」扱い）
+  if (sb_spill_write(s, blk->data, blk->size, s->sb_spill_size) != 0) return -1;
+  if (blk->bloom_bytes > 0 &&
+      sb_spill_write(s, blk->bloom, blk->bloom_bytes, s->sb_spill_size + blk->size) != 0) return -1;
+
+  SbColdBlock e = *blk;
+  e.data = NULL;
+  e.bloom = NULL;
+  e.off = s->sb_spill_size;
+  s->sb_spill[s->sb_spill_count++] = e;
+  s->sb_spill_size += blk->size + blk->bloom_bytes;
+  return 0;
+}
+
+static int sb_spill_write(Session *s, const void *data, size_t len, uint64_t off) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t w = pwrite(s->sb_spill_fd, (const uint8_t*)data + done, len - done, (off_t)(off + done));
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) {
+      fprintf(stderr, "scrollback: spill write: %s\n", w < 0 ? strerror(errno) : "short write");
+      return -1;
+    }
+    done += (size_t)w;
+  }
+  return 0;
+}
+
+static void sb_spill_close(Session *s) {
+  if (s->sb_spill_fd >= 0) close(s->sb_spill_fd);
+  for (int b = 0; b < s->sb_spill_count; b++) sb_block_free(&s->sb_spill[b]);
+  free(s->sb_spill);
+  s->sb_spill_fd = -1;
+  s->sb_spill = NULL;
+  s->sb_spill_count = 0;
+  s->sb_spill_cap = 0;
+  s->sb_spill_size = 0;
+}
+
+// 論理行 i を含むスピル・cold ブロック（hot の行なら NULL）。どちらも添字で引ける
+static const SbColdBlock *sb_block_at(Session *s, int i) {
+  int b = i / SB_BLOCK_LINES;
+  if (b < s->sb_spill_count) return &s->sb_spill[b];
+  b -= s->sb_spill_count;
+  if (b < s->sb_cold_count) return &s->sb_cold[b];
+  return NULL;
+}
+
+static const ScrollbackCell *sb_block_decoded(Session *s, const SbColdBlock *blk) {
+  SbDecodedBlock *victim = &s->sb_decoded[0];
+
+  for (int k = 0; k < SB_DECODE_CACHE; k++) {
+    SbDecodedBlock *d = &s->sb_decoded[k];
+    if (d->seq == blk->seq) {
+      d->last_used = ++s->sb_decode_clock;
+      return d->cells;
+    }
+    if (d->seq == 0 || (victim->seq != 0 && d->last_used < victim->last_used)) victim = d;
+  }
+
+  if (!victim->cells) {
+    victim->cells = malloc((size_t)SB_BLOCK_LINES * TERM_COLS * sizeof(ScrollbackCell));
+    if (!victim->cells) return NULL;
+  }
+
+  memset(victim->cells, 0, (size_t)SB_BLOCK_LINES * TERM_COLS * sizeof(ScrollbackCell));
+  if (sb_block_decode(s, blk, victim->cells) != 0) {
+    fprintf(stderr, "scrollback: corrupt block %llu\n", (unsigned long long)blk->seq);
+    ScrollbackCell blank = sb_cell_blank();
+    for (int i = 0; i < SB_BLOCK_LINES * TERM_COLS; i++) victim->cells[i] = blank;
+  }
+
+  victim->seq = blk->seq;
+  victim->last_used = ++s->sb_decode_clock;
+  return victim->cells;
+}
+
+// スピル済みのブロックはその範囲だけ mmap して展開する
+static int sb_block_decode(Session *s, const SbColdBlock *blk, ScrollbackCell *out) {
+  const uint8_t *data = blk->data;
+  void *map = NULL;
+  size_t map_len = 0;
+
+  if (!data) {
+    if (s->sb_spill_fd < 0) return -1;
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = blk->off - blk->off % page;
+    map_len = (size_t)(blk->off - start) + blk->size;
+    map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, s->sb_spill_fd, (off_t)start);
+    if (map == MAP_FAILED) return -1;
+    data = (const uint8_t*)map + (blk->off - start);
+  }
+
+  const uint8_t *p = data;
+  const uint8_t *end = data + blk->size;
+  int rc = 0;
+  if (sb_rle_decode(&p, end, out, 0) != 0 || sb_rle_decode(&p, end, out, 1) != 0) rc = -1;
+
+  if (map) munmap(map, map_len);
+  return rc;
+}
+
+// 面 0 はコードポイント、面 1 は幅・属性・色
+static uint64_t sb_plane_value(const ScrollbackCell *const *rows, int i, int plane) {
+  ScrollbackCell c = rows[i / TERM_COLS][i % TERM_COLS];
+  return plane == 0 ? (c & 0x1FFFFF) : (c >> SB_CELL_WIDTH_SHIFT);
+}
+
+// 見出し varint: 奇数なら (n>>1) 回繰り返す値が1つ、偶数なら (n>>1) 個の値がそのまま続く
+static uint8_t *sb_rle_encode(uint8_t *p, const ScrollbackCell *const *rows, int plane) {
+  const int n = SB_BLOCK_LINES * TERM_COLS;
+  int i = 0;
+
+  while (i < n) {
+    uint64_t v = sb_plane_value(rows, i, plane);
+    int run = 1;
+    while (i + run < n && sb_plane_value(rows, i + run, plane) == v) run++;
+
+    if (run >= 3) {
+      p += sb_put_varint(p, ((uint64_t)run << 1) | 1);
+      p += sb_put_varint(p, v);
+      i += run;
+      continue;
+    }
+
+    int j = i + 1;
+    while (j < n) {
+      uint64_t w = sb_plane_value(rows, j, plane);
+      if (j + 2 < n && sb_plane_value(rows, j + 1, plane) == w && sb_plane_value(rows, j + 2, plane) == w) break;
+      j++;
+    }
+    p += sb_put_varint(p, (uint64_t)(j - i) << 1);
+    for (; i < j; i++) p += sb_put_varint(p, sb_plane_value(rows, i, plane));
+  }
+  return p;
+}
+
+static int sb_rle_decode(const uint8_t **pp, const uint8_t *end, ScrollbackCell *out, int plane) {
+  const int n = SB_BLOCK_LINES * TERM_COLS;
+  const int shift = plane == 0 ? 0 : SB_CELL_WIDTH_SHIFT;
+  int i = 0;
+
+  while (i < n) {
+    uint64_t hdr, v;
+    if (sb_get_varint(pp, end, &hdr) != 0) return -1;
+    uint64_t len = hdr >> 1;
+    if (len == 0 || len > (uint64_t)(n - i)) return -1;
+
+    if (hdr & 1) {
+      if (sb_get_varint(pp, end, &v) != 0) return -1;
+      for (uint64_t k = 0; k < len; k++) out[i++] |= (ScrollbackCell)v << shift;
+    } else {
+      for (uint64_t k = 0; k < len; k++) {
+        if (sb_get_varint(pp, end, &v) != 0) return -1;
+        out[i++] |= (ScrollbackCell)v << shift;
+      }
+    }
+  }
+  return 0;
+}
+
+static size_t sb_put_varint(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+static int sb_get_varint(const uint8_t **pp, const uint8_t *end, uint64_t *v) {
+  const uint8_t *p = *pp;
+  uint64_t r = 0;
+  for (int sh = 0; sh < 64; sh += 7) {
+    if (p >= end) return -1;
+    uint8_t b = *p++;
+    r |= (uint64_t)(b & 0x7F) << sh;
+    if (!(b & 0x80)) {
+      *pp = p;
+      *v = r;
+      return 0;
+    }
+  }
+  return -1;
+}
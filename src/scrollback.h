@@ -7,6 +7,20 @@ void sb_region_ensure_visible(App* app);
 void sb_region_enter(App* app);
 void sb_region_exit(App* app);
 void sb_region_line_hl_range(App *app, int vline, int *from, int *to);
-int sb_phys_index(App *app, int i);
 int sb_virtual_start_line(App *app);
 int sb_virtual_total_lines(App* app);
+uint64_t sb_virtual_line_id(const Session *s, int vline);
+void sb_store_init(Session *s, int max_lines);
+void sb_store_free(Session *s);
+void sb_store_clear(Session *s);
+ScrollbackCell *sb_store_push(Session *s, int continuation);
+const ScrollbackCell *sb_line(Session *s, int i);
+int sb_line_cont(Session *s, int i);
+int sb_block_count(const Session *s);
+int sb_block_maybe_contains(Session *s, int block, const uint32_t *hashes, int n);
+void sb_colors_reset(SbColorTable *t);
+void sb_colors_maybe_sweep(Session *s);
+unsigned sb_color_id(SbColorTable *t, VTermColor c);
+void sb_line_pack(Session *s, ScrollbackCell *dst, const VTermScreenCell *cells, int cols);
+ScrollbackCell sb_cell_blank(void);
+SDL_Color sb_color_to_sdl(App *app, Session *s, unsigned id);
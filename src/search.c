@@ -0,0 +1,335 @@
+#include "search.h"
+#include "scrollback.h"
+#include "term.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_BLOOM_K 3
+
+static void search_refresh(App *app);
+static int search_find(App *app, int from_line, int from_col, int dir);
+static int search_line_text(App *app, int vline, uint32_t *cps, uint8_t *cols, uint8_t *widths);
+static int search_line_find(const SbSearch *q, const uint32_t *cps, const uint8_t *cols, int n,
+                            int limit, int dir, int *out_i);
+static int search_query_hashes(const SbSearch *q, uint32_t *out);
+static void search_scroll_to(App *app, int vline);
+static void search_bloom_add(uint8_t *bloom, uint32_t mask, uint32_t h);
+static int search_bloom_has(const uint8_t *bloom, uint32_t mask, uint32_t h);
+static uint32_t search_fold(uint32_t cp);
+static uint32_t search_gram_hash(uint32_t a, uint32_t b, uint32_t c);
+
+void search_enter(App *app) {
+  Session *s = SESSION(app);
+  unsigned seq = s->search.seq;
+
+  sb_region_exit(app);
+  memset(&s->search, 0, sizeof(s->search));
+  s->search.active = 1;
+  s->search.match_line = -1;
+  s->search.seq = seq + 1;
+}
+
+void search_exit(App *app) {
+  SbSearch *q = &SESSION(app)->search;
+  q->active = 0;
+  q->match_line = -1;
+  q->seq++;
+}
+
+// 一致箇所をリージョンの選択範囲にして抜ける（そのまま範囲を調整してコピーできる）
+void search_accept(App *app) {
+  Session *s = SESSION(app);
+  SbSearch *q = &s->search;
+
+  if (q->match_line >= 0) {
+    s->region_mode = 1;
+    s->selecting = 1;
+    s->sel_line = q->match_line;
+    s->sel_col = q->match_col;
+    s->reg_line = q->match_line;
+    s->reg_col = q->match_end_col;
+  }
+  search_exit(app);
+}
+
+// 検索中のソフトウェアキーボード入力は PTY ではなく検索語へ
+void search_input_key(App *app, const char *k) {
+  SbSearch *q = &SESSION(app)->search;
+
+  if (strcmp(k, "Esc") == 0 || strcmp(k, "CUR") == 0) { search_exit(app); return; }
+  if (strcmp(k, "ENT") == 0) { search_step(app, -1); return; }
+  if (strcmp(k, "BS") == 0) {
+    if (q->len == 0) { search_exit(app); return; }
+    q->query[--q->len] = '\0';
+    search_refresh(app);
+    return;
+  }
+
+  char c;
+  if (strcmp(k, "SP") == 0) c = ' ';
+  else if (k[0] >= 0x20 && k[0] < 0x7f && k[1] == '\0') c = k[0];
+  else return;   // 修飾キー・Tab など
+
+  if (q->len >= SEARCH_QUERY_MAX) return;
+  q->query[q->len++] = c;
+  q->query[q->len] = '\0';
+  search_refresh(app);
+}
+
+// dir < 0 で古い方、dir > 0 で新しい方の次の一致へ。無ければ今の一致のまま
+void search_step(App *app, int dir) {
+  SbSearch *q = &SESSION(app)->search;
+  if (q->len == 0) return;
+
+  int line, col;
+  if (q->match_line >= 0) {
+    line = q->match_line;
+    col = q->match_col;
+  } else if (dir < 0) {
+    line = sb_virtual_total_lines(app) - 1;
+    col = TERM_COLS;
+  } else {
+    line = 0;
+    col = -1;
+  }
+
+  int save_line = q->match_line, save_col = q->match_col, save_end = q->match_end_col;
+  if (search_find(app, line, col, dir)) {
+    q->failed = 0;
+    search_scroll_to(app, q->match_line);
+  } else {
+    q->match_line = save_line;
+    q->match_col = save_col;
+    q->match_end_col = save_end;
+    q->failed = 1;
+  }
+  q->seq++;
+}
+
+// ブロック内の各行の 3 文字の並び（大文字小文字を区別しない）を要約する。大きさは並びの異なり数から
+// 1 つあたり SB_BLOOM_BITS_PER_GRAM ビット以上の2の冪に決める（確保できなければ NULL、*out_bytes = 0）
+uint8_t *search_bloom_build(const ScrollbackCell *const *rows, int nrows, uint32_t *out_bytes) {
+  *out_bytes = 0;
+
+  // 異なり数を数えながら重複を除く（開番地のハッシュ集合。0 は空きの印なので 1 に寄せる）
+  uint32_t set_size = 1024;
+  while (set_size < (uint32_t)nrows * TERM_COLS * 2) set_size *= 2;
+  uint32_t *grams = malloc((size_t)nrows * TERM_COLS * sizeof(uint32_t));
+  uint32_t *set = calloc(set_size, sizeof(uint32_t));
+  if (!grams || !set) {
+    free(grams);
+    free(set);
+    return NULL;
+  }
+
+  int distinct = 0;
+  for (int l = 0; l < nrows; l++) {
+    uint32_t a = 0, b = 0;
+    int len = 0;
+    for (int c = 0; c < TERM_COLS; c++) {
+      ScrollbackCell cell = rows[l][c];
+      if (sb_cell_width(cell) == 0) continue;
+      uint32_t cp = sb_cell_cp(cell);
+      cp = search_fold(cp ? cp : ' ');
+      if (++len >= 3) {
+        uint32_t h = search_gram_hash(a, b, cp);
+        if (h == 0) h = 1;
+        uint32_t i = h & (set_size - 1);
+        while (set[i] && set[i] != h) i = (i + 1) & (set_size - 1);
+        if (!set[i]) set[i] = grams[distinct++] = h;
+      }
+      a = b;
+      b = cp;
+    }
+  }
+  free(set);
+
+  uint32_t bytes = SB_BLOOM_MIN_BYTES;
+  while (bytes < SB_BLOOM_MAX_BYTES && bytes * 8 < (uint32_t)distinct * SB_BLOOM_BITS_PER_GRAM) bytes *= 2;
+
+  uint8_t *bloom = calloc(bytes, 1);
+  if (bloom) {
+    for (int i = 0; i < distinct; i++) search_bloom_add(bloom, bytes * 8 - 1, grams[i]);
+    *out_bytes = bytes;
+  }
+  free(grams);
+  return bloom;
+}
+
+// 0 なら確実に含まない
+int search_bloom_test(const uint8_t *bloom, uint32_t bytes, const uint32_t *hashes, int n) {
+  for (int i = 0; i < n; i++) {
+    if (!search_bloom_has(bloom, bytes * 8 - 1, hashes[i])) return 0;
+  }
+  return 1;
+}
+
+// 検索語が変わったら今の一致位置（無ければ末尾）から古い方へ探し直す
+static void search_refresh(App *app) {
+  SbSearch *q = &SESSION(app)->search;
+  q->failed = 0;
+
+  if (q->len == 0) {
+    q->match_line = -1;
+  } else {
+    int line = q->match_line, col = q->match_col + 1;
+    if (line < 0) {
+      line = sb_virtual_total_lines(app) - 1;
+      col = TERM_COLS;
+    }
+    if (search_find(app, line, col, -1)) {
+      search_scroll_to(app, q->match_line);
+    } else {
+      q->match_line = -1;
+      q->failed = 1;
+    }
+  }
+  q->seq++;
+}
+
+// (from_line, from_col) を含まずに dir の向きへ探す。圧縮済みの行はブロックの要約で読み飛ばす
+static int search_find(App *app, int from_line, int from_col, int dir) {
+  Session *s = SESSION(app);
+  SbSearch *q = &s->search;
+
+  uint32_t hashes[SEARCH_QUERY_MAX];
+  int nh = search_query_hashes(q, hashes);
+
+  int total = sb_virtual_total_lines(app);
+  int indexed = sb_block_count(s) * SB_BLOCK_LINES;
+  int checked_block = -1;
+
+  uint32_t cps[TERM_COLS];
+  uint8_t cols[TERM_COLS], widths[TERM_COLS];
+
+  int v = from_line;
+  while (v >= 0 && v < total) {
+    if (v < indexed) {
+      // 2文字までは要約で絞れないので、圧縮済みの行（スピル分も）は展開せず非圧縮の行と画面だけ
+      if (nh == 0) {
+        if (dir < 0) break;
+        v = indexed;
+        continue;
+      }
+      int b = v / SB_BLOCK_LINES;
+      if (b != checked_block) {
+        checked_block = b;
+        if (!sb_block_maybe_contains(s, b, hashes, nh)) {
+          v = (dir < 0) ? b * SB_BLOCK_LINES - 1 : (b + 1) * SB_BLOCK_LINES;
+          continue;
+        }
+      }
+    }
+
+    int n = search_line_text(app, v, cps, cols, widths);
+    int limit = (v == from_line) ? from_col : (dir < 0 ? TERM_COLS : -1);
+    int i;
+    if (search_line_find(q, cps, cols, n, limit, dir, &i)) {
+      int last = i + q->len - 1;
+      q->match_line = v;
+      q->match_col = cols[i];
+      q->match_end_col = cols[last] + widths[last] - 1;
+      return 1;
+    }
+    v += dir;
+  }
+  return 0;
+}
+
+// 仮想行の文字を幅0のセルを除いて並べる（cols は各文字のセル位置）
+static int search_line_text(App *app, int vline, uint32_t *cps, uint8_t *cols, uint8_t *widths) {
+  Session *s = SESSION(app);
+  int n = 0;
+
+  if (vline < s->sb_count) {
+    const ScrollbackCell *line = sb_line(s, vline);
+    if (!line) return 0;
+    for (int c = 0; c < TERM_COLS; c++) {
+      int w = sb_cell_width(line[c]);
+      if (w == 0) continue;
+      uint32_t cp = sb_cell_cp(line[c]);
+      cps[n] = search_fold(cp ? cp : ' ');
+      cols[n] = (uint8_t)c;
+      widths[n] = (uint8_t)w;
+      n++;
+    }
+    return n;
+  }
+
+  const ScreenCell *row = term_screen_row(s, vline - s->sb_count);
+  for (int c = 0; c < TERM_COLS; c++) {
+    if (row[c].width == 0) continue;
+    cps[n] = search_fold(row[c].ch);
+    cols[n] = (uint8_t)c;
+    widths[n] = row[c].width;
+    n++;
+  }
+  return n;
+}
+
+// 開始セルが limit より手前（dir < 0）または後ろ（dir > 0）で最も近い一致
+static int search_line_find(const SbSearch *q, const uint32_t *cps, const uint8_t *cols, int n,
+                            int limit, int dir, int *out_i) {
+  if (q->len > n) return 0;
+
+  int i = (dir < 0) ? n - q->len : 0;
+  for (; i >= 0 && i + q->len <= n; i += (dir < 0) ? -1 : 1) {
+    if (dir < 0 ? cols[i] >= limit : cols[i] <= limit) continue;
+
+    int j = 0;
+    while (j < q->len && cps[i + j] == search_fold((unsigned char)q->query[j])) j++;
+    if (j == q->len) {
+      *out_i = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// 検索語の trigram。3文字未満は 0（圧縮済みの行は調べない）
+static int search_query_hashes(const SbSearch *q, uint32_t *out) {
+  uint32_t f[SEARCH_QUERY_MAX];
+  for (int i = 0; i < q->len; i++) f[i] = search_fold((unsigned char)q->query[i]);
+
+  int n = 0;
+  for (int i = 0; i + 2 < q->len; i++) out[n++] = search_gram_hash(f[i], f[i + 1], f[i + 2]);
+  return n;
+}
+
+// 一致した行が画面外なら中央に来るようにスクロールする
+static void search_scroll_to(App *app, int vline) {
+  Session *s = SESSION(app);
+  int start = sb_virtual_start_line(app);
+  if (vline >= start && vline < start + TERM_ROWS) return;
+
+  int new_start = sb_clampi(vline - TERM_ROWS / 2, 0, s->sb_count);
+  s->view_offset_lines = s->sb_count - new_start;
+}
+
+// h から2つ目のハッシュを作って h1 + i*h2 の K 箇所（mask はビット数 - 1）
+static void search_bloom_add(uint8_t *bloom, uint32_t mask, uint32_t h) {
+  uint32_t h2 = (h * 0x9E3779B1u) >> 7 | 1;
+  for (int i = 0; i < SEARCH_BLOOM_K; i++, h += h2) bloom[(h & mask) / 8] |= (uint8_t)(1u << (h % 8));
+}
+
+static int search_bloom_has(const uint8_t *bloom, uint32_t mask, uint32_t h) {
+  uint32_t h2 = (h * 0x9E3779B1u) >> 7 | 1;
+  for (int i = 0; i < SEARCH_BLOOM_K; i++, h += h2) {
+    if (!(bloom[(h & mask) / 8] & (1u << (h % 8)))) return 0;
+  }
+  return 1;
+}
+
+
+static uint32_t search_fold(uint32_t cp) {
+  return (cp >= 'A' && cp <= 'Z') ? cp + ('a' - 'A') : cp;
+}
+
+static uint32_t search_gram_hash(uint32_t a, uint32_t b, uint32_t c) {
+  uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  return h;
+}
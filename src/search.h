@@ -0,0 +1,11 @@
+#pragma once
+
+#include "app.h"
+
+void search_enter(App *app);
+void search_exit(App *app);
+void search_accept(App *app);
+void search_input_key(App *app, const char *k);
+void search_step(App *app, int dir);
+uint8_t *search_bloom_build(const ScrollbackCell *const *rows, int nrows, uint32_t *out_bytes);
+int search_bloom_test(const uint8_t *bloom, uint32_t bytes, const uint32_t *hashes, int n);
@@ -1,23 +1,52 @@
 #include "session.h"
+#include "evloop.h"
+#include "grid.h"
+#include "scrollback.h"
 #include "term.h"
+#include "util.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
 #include <pty.h>
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
 static void session_init(App* app, Session *s);
+static void session_start_threads(Session *s);
+static void session_stop_threads(Session *s);
+static void *session_reader_main(void *arg);
+static void *session_parser_main(void *arg);
+static void session_ring_notify(Session *s, pthread_cond_t *cv);
+static void session_out_append_locked(Session *s, const void *data, size_t n);
+static void session_paste_finish(Session *s);
+static void session_cb_output(const char *bytes, size_t len, void *user);
 static void session_start_shell(Session *s);
 static void session_init_vterm(Session *s);
+static int session_cb_osc(int command, VTermStringFragment frag, void *user);
+#ifndef GKD_VTERM_STATE_BACKEND
+static int session_cb_damage(VTermRect rect, void *user);
+static int session_cb_moverect(VTermRect dest, VTermRect src, void *user);
 static int session_cb_sb_clear(void *user);
 static int session_cb_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user);
 
 static const VTermScreenCallbacks screen_cb = {
+  .damage       = session_cb_damage,
+  .moverect     = session_cb_moverect,
   .sb_clear     = session_cb_sb_clear,
   .sb_pushline4 = session_cb_sb_pushline4,
 };
+#endif
+
+static const VTermStateFallbacks fallbacks_cb = {
+  .osc = session_cb_osc,
+};
 
 int session_is_locked(const Session *s) {
   if (!s->used || s->pty_fd < 0 || s->pid <= 0) return 0;
@@ -38,18 +67,32 @@ int session_create(App* app, int idx) {
 
   session_init(app, s);
   s->used = 1;
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_mutex_init(&s->ring_mtx, NULL);
+  pthread_cond_init(&s->ring_data_cv, NULL);
+  pthread_cond_init(&s->ring_space_cv, NULL);
+  pthread_mutex_init(&s->out_mtx, NULL);
 
   session_start_shell(s);
   session_init_vterm(s);
 
-  s->sb_head = 0;
-  s->sb_count = 0;
   s->view_offset_lines = 0;
-  memset(s->sb_cont, 0, sizeof(s->sb_cont));
+  sb_store_init(s, app->cfg.scrollback_lines);
+  memset(s->dirty_rows, 1, sizeof(s->dirty_rows));
+  memset(s->screen_stale, 1, sizeof(s->screen_stale));
+  for (int r = 0; r < TERM_ROWS; r++) s->screen_row_id[r] = (uint64_t)r + 1;
+  s->screen_id_next = TERM_ROWS + 1;
 
   s->region_mode = 0;
   s->selecting = 0;
 
+  // UI スレッドが全セッションをロック中（入力処理から作られた）なら揃えておく
+  if (app->sess_lock_mask) {
+    pthread_mutex_lock(&s->lock);
+    app->sess_lock_mask |= 1u << idx;
+  }
+
+  session_start_threads(s);
   return 0;
 }
 
@@ -58,14 +101,31 @@ void session_destroy(App* app, int idx) {
   Session *s = &app->sessions[idx];
   if (!s->used) return;
 
+  // 解析スレッドが lock 待ちのまま join しないよう先に手放す
+  if (app->sess_lock_mask & (1u << idx)) {
+    app->sess_lock_mask &= ~(1u << idx);
+    pthread_mutex_unlock(&s->lock);
+  }
+
   if (s->pid > 0) {
     kill(s->pid, SIGHUP);
     waitpid(s->pid, NULL, WNOHANG);
   }
 
+  session_stop_threads(s);
+  evloop_watch_writable(app, idx, 0);
+  free(s->out.buf);
+  free(s->paste.data);
+  sb_store_free(s);
   if (s->pty_fd >= 0) close(s->pty_fd);
   if (s->vt) vterm_free(s->vt);
 
+  pthread_mutex_destroy(&s->lock);
+  pthread_mutex_destroy(&s->ring_mtx);
+  pthread_cond_destroy(&s->ring_data_cv);
+  pthread_cond_destroy(&s->ring_space_cv);
+  pthread_mutex_destroy(&s->out_mtx);
+
   session_init(app, s);
   s->used = 0;
 }
@@ -80,24 +140,170 @@ void session_switch(App* app, int idx) {
   app->active_sess = idx;
 }
 
+// 読み出し・解析は各セッションのスレッドが行う。ここでは表示中のセッションに
+// 新しい出力があったかだけを見る（裏のセッションの印は切替時の全描画で不要になる）
 int sessions_pump_io(App* app) {
-  unsigned char buf[512];
   int active_changed = 0;
 
   for (int i = 0; i < MAX_SESSIONS; i++) {
     Session *s = &app->sessions[i];
-    if (!s->used || s->pty_fd < 0) continue;
+    if (!s->used) continue;
 
-    int n;
-    while ((n = read(s->pty_fd, buf, sizeof(buf))) > 0) {
-      vterm_input_write(s->vt, (const char*)buf, n);
-      vterm_screen_flush_damage(s->vts);
-      if (i == app->active_sess) active_changed = 1;
-    }
+    if (atomic_exchange(&s->output_pending, 0) && i == app->active_sess) active_changed = 1;
   }
   return active_changed;
 }
 
+// PTY へ送るキー入力を積む（書き込みは sessions_flush_output でまとめて）。
+// libvterm の応答（DSR など）は解析スレッドから積まれるので out_mtx で守る。
+// 貼り付けの途中なら残りを捨てて括弧を閉じてから積む（括弧の中だとシェルは Ctrl-C も文字として読む）。
+// s->lock を持った状態で呼ぶ（入力処理は sessions_lock_all の中）
+void session_out_append(Session *s, const void *data, size_t n) {
+  if (!s->used || s->pty_fd < 0 || n == 0) return;
+
+  if (s->paste.data) {
+    fprintf(stderr, "session: paste interrupted by key input at %zu/%zu bytes\n", s->paste.off, s->paste.len);
+    session_paste_finish(s);
+  }
+
+  pthread_mutex_lock(&s->out_mtx);
+  session_out_append_locked(s, data, n);
+  pthread_mutex_unlock(&s->out_mtx);
+}
+
+// 貼り付けを始める。本文は sessions_flush_output がキューの空き具合を見ながら少しずつ流す。
+// 端末が DECSET 2004 を有効にしていれば libvterm が ESC[200~ / ESC[201~ で囲む。
+// s->lock を持った状態で呼ぶ（vterm を触るため）
+void session_paste_start(Session *s, const char *text, size_t len) {
+  if (!s->used || s->pty_fd < 0 || len == 0) return;
+
+  if (s->paste.data) {
+    fprintf(stderr, "session: paste already in progress, ignored\n");
+    return;
+  }
+
+  // 本文中の終了マーカーで括弧付き貼り付けを抜けられないよう取り除く
+  static const char end_marker[] = "\x1b[201~";
+  const size_t end_len = sizeof(end_marker) - 1;
+
+  char *buf = (char*)malloc(len);
+  if (!buf) return;
+  size_t n = 0;
+  for (size_t i = 0; i < len; ) {
+    if (len - i >= end_len && memcmp(text + i, end_marker, end_len) == 0) { i += end_len; continue; }
+    buf[n++] = text[i++];
+  }
+
+  vterm_keyboard_start_paste(s->vt);
+
+  s->paste.data = buf;
+  s->paste.len = n;
+  s->paste.off = 0;
+}
+
+// 貼り付けを終える（流し切った時も途中で打ち切る時も）。
+// 終了マーカーは出力コールバック経由で積まれるので、out_mtx を持たず s->lock を持って呼ぶ
+static void session_paste_finish(Session *s) {
+  free(s->paste.data);
+  s->paste = (PasteStream){0};
+  vterm_keyboard_end_paste(s->vt);
+}
+
+// 進行中の貼り付けの進み具合（0〜100）。無ければ -1
+int session_paste_progress(const Session *s) {
+  if (!s->paste.data || s->paste.len == 0) return -1;
+  return (int)(s->paste.off * 100 / s->paste.len);
+}
+
+// 各セッションの書き込み待ちを書けるだけ書く（1周で PTY_WRITE_CHUNK まで）。
+// 書き残し・貼り付けの続きがあれば EPOLLOUT で起きて続きを書く
+void sessions_flush_output(App* app) {
+  for (int i = 0; i < MAX_SESSIONS; i++) {
+    Session *s = &app->sessions[i];
+    PtyOutQueue *q = &s->out;
+    if (!s->used) continue;
+
+    int paste_done = 0;
+    pthread_mutex_lock(&s->out_mtx);
+
+    // キューが減ってきたら貼り付けの続きを補充する
+    if (s->paste.data && q->len - q->off < PASTE_QUEUE_LOW) {
+      size_t n = s->paste.len - s->paste.off;
+      if (n > PASTE_QUEUE_LOW) n = PASTE_QUEUE_LOW;
+      session_out_append_locked(s, s->paste.data + s->paste.off, n);
+      s->paste.off += n;
+      if (s->paste.off >= s->paste.len) paste_done = 1;
+    }
+
+    size_t budget = PTY_WRITE_CHUNK;
+    while (q->off < q->len && budget > 0) {
+      size_t n = q->len - q->off;
+      if (n > budget) n = budget;
+
+      ssize_t w = write(s->pty_fd, q->buf + q->off, n);
+      if (w > 0) {
+        q->off += (size_t)w;
+        budget -= (size_t)w;
+        app->stats.pty_writes++;
+        app->stats.pty_write_bytes += (Uint32)w;
+        continue;
+      }
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0 && errno == EAGAIN) break;
+
+      // EIO など: シェルが居ないので捨てる
+      q->off = q->len = 0;
+      if (s->paste.data) paste_done = 1;
+      break;
+    }
+
+    if (q->off == q->len) q->off = q->len = 0;
+    int pending = q->off < q->len;
+    pthread_mutex_unlock(&s->out_mtx);
+
+    if (paste_done) {
+      session_lock(s);
+      session_paste_finish(s);
+      session_unlock(s);
+      pending = 1;
+    }
+
+    evloop_watch_writable(app, i, pending || s->paste.data != NULL);
+  }
+}
+
+// 入力処理の間は全セッションを止める（セッション切替・作成・削除をまたいでも一貫させる）
+void sessions_lock_all(App* app) {
+  for (int i = 0; i < MAX_SESSIONS; i++) {
+    Session *s = &app->sessions[i];
+    if (!s->used) continue;
+    session_lock(s);
+    app->sess_lock_mask |= 1u << i;
+  }
+}
+
+void sessions_unlock_all(App* app) {
+  for (int i = 0; i < MAX_SESSIONS; i++) {
+    if (!(app->sess_lock_mask & (1u << i))) continue;
+    pthread_mutex_unlock(&app->sessions[i].lock);
+  }
+  app->sess_lock_mask = 0;
+}
+
+// 描画中は表示中のセッションだけ止める
+// ui_waiting を立てておくと解析スレッドは予算の途中でもロックを手放して譲る。
+// これで UI の待ち時間は最悪でも PTY_PARSE_SLICE 1回分に収まる
+void session_lock(Session *s) {
+  if (!s->used) return;
+  atomic_fetch_add(&s->ui_waiting, 1);
+  pthread_mutex_lock(&s->lock);
+  atomic_fetch_sub(&s->ui_waiting, 1);
+}
+
+void session_unlock(Session *s) {
+  if (s->used) pthread_mutex_unlock(&s->lock);
+}
+
 int sessions_alive_count(App* app) {
   int n = 0;
   for (int i = 0; i < MAX_SESSIONS; i++) if (app->sessions[i].used) n++;
@@ -116,6 +322,216 @@ static void session_init(App* app, Session *s) {
   memset(s, 0, sizeof(*s));
   s->app = app;
   s->pty_fd = -1;
+  s->stop_fd = -1;
+  s->sb_spill_fd = -1;
+}
+
+static void session_start_threads(Session *s) {
+  atomic_store(&s->stop, 0);
+  atomic_store(&s->ring.head, 0);
+  atomic_store(&s->ring.tail, 0);
+  s->read_size = PTY_READ_MIN;
+
+  s->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (s->stop_fd < 0 || s->pty_fd < 0) {
+    fprintf(stderr, "session: cannot start PTY threads\n");
+    return;
+  }
+
+  if (pthread_create(&s->parser_thread, NULL, session_parser_main, s) != 0) {
+    fprintf(stderr, "session: parser thread failed\n");
+    return;
+  }
+  if (pthread_create(&s->reader_thread, NULL, session_reader_main, s) != 0) {
+    fprintf(stderr, "session: reader thread failed\n");
+    atomic_store(&s->stop, 1);
+    session_ring_notify(s, &s->ring_data_cv);
+    pthread_join(s->parser_thread, NULL);
+    return;
+  }
+  s->threads_started = 1;
+}
+
+static void session_stop_threads(Session *s) {
+  if (s->threads_started) {
+    atomic_store(&s->stop, 1);
+    uint64_t one = 1;
+    (void)write(s->stop_fd, &one, sizeof(one));
+    session_ring_notify(s, &s->ring_data_cv);
+    session_ring_notify(s, &s->ring_space_cv);
+
+    pthread_join(s->reader_thread, NULL);
+    pthread_join(s->parser_thread, NULL);
+    s->threads_started = 0;
+  }
+  if (s->stop_fd >= 0) { close(s->stop_fd); s->stop_fd = -1; }
+}
+
+// 読み出しスレッド: PTY → リング。リングが満杯なら読まずに待つ（カーネル側で詰まる）。
+// read() の大きさは出力の勢いに合わせて PTY_READ_MIN〜PTY_READ_MAX で伸縮する
+static void *session_reader_main(void *arg) {
+  Session *s = (Session*)arg;
+  PtyRing *rb = &s->ring;
+  struct pollfd pfd[2] = {
+    { .fd = s->pty_fd,  .events = POLLIN },
+    { .fd = s->stop_fd, .events = POLLIN },
+  };
+
+  while (!atomic_load(&s->stop)) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t space = PTY_RING_SIZE - (head - tail);
+
+    if (space == 0) {
+      pthread_mutex_lock(&s->ring_mtx);
+      while (!atomic_load(&s->stop) &&
+             atomic_load_explicit(&rb->tail, memory_order_acquire) == tail) {
+        pthread_cond_wait(&s->ring_space_cv, &s->ring_mtx);
+      }
+      pthread_mutex_unlock(&s->ring_mtx);
+      continue;
+    }
+
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (pfd[1].revents) break;
+
+    // 折り返しをまたがない連続領域に直接読む
+    size_t off = head & (PTY_RING_SIZE - 1);
+    size_t len = PTY_RING_SIZE - off;
+    if (len > space) len = space;
+    if (len > s->read_size) len = s->read_size;
+
+    ssize_t n = read(s->pty_fd, rb->buf + off, len);
+    if (n > 0) {
+      atomic_store_explicit(&rb->head, head + (size_t)n, memory_order_release);
+      session_ring_notify(s, &s->ring_data_cv);
+
+      // 要求いっぱいに読めたらまだ溜まっている: 次は大きく読む。細い出力なら戻す
+      if ((size_t)n == len && len == s->read_size && s->read_size < PTY_READ_MAX) s->read_size *= 2;
+      else if ((size_t)n < s->read_size / 4 && s->read_size > PTY_READ_MIN) s->read_size /= 2;
+
+      atomic_fetch_add_explicit(&s->rx_total, (uint64_t)n, memory_order_relaxed);
+      atomic_fetch_add_explicit(&s->st_read_bytes, (uint64_t)n, memory_order_relaxed);
+      atomic_fetch_add_explicit(&s->st_reads, 1, memory_order_relaxed);
+    } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      continue;
+    } else {
+      break;   // EOF / EIO: シェルが終了した
+    }
+  }
+  return NULL;
+}
+
+// 解析スレッド: リング → libvterm。vterm への書き込みは lock の中で行う
+static void *session_parser_main(void *arg) {
+  Session *s = (Session*)arg;
+  PtyRing *rb = &s->ring;
+
+  for (;;) {
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+    if (head == tail) {
+      if (atomic_load(&s->stop)) break;
+      pthread_mutex_lock(&s->ring_mtx);
+      while (!atomic_load(&s->stop) &&
+             atomic_load_explicit(&rb->head, memory_order_acquire) == tail) {
+        pthread_cond_wait(&s->ring_data_cv, &s->ring_mtx);
+      }
+      pthread_mutex_unlock(&s->ring_mtx);
+      continue;
+    }
+
+    // 溜まっている分をまとめて流し、damage の flush は1回だけ。
+    // ただしロックを握るのは PTY_PARSE_BUDGET_NS まで、UI が待っていればその場で手放す
+    pthread_mutex_lock(&s->lock);
+    uint64_t t0 = util_now_ns();
+    uint64_t spent = 0;
+    while (tail != head) {
+      size_t off = tail & (PTY_RING_SIZE - 1);
+      size_t len = head - tail;
+      if (len > PTY_RING_SIZE - off) len = PTY_RING_SIZE - off;
+      if (len > PTY_PARSE_SLICE) len = PTY_PARSE_SLICE;
+
+      vterm_input_write(s->vt, (const char*)rb->buf + off, len);
+      tail += len;
+      atomic_store_explicit(&rb->tail, tail, memory_order_release);
+
+      spent = util_now_ns() - t0;
+      if (spent >= PTY_PARSE_BUDGET_NS || atomic_load(&s->ui_waiting)) break;
+    }
+#ifndef GKD_VTERM_STATE_BACKEND
+    vterm_screen_flush_damage(s->vts);
+#endif
+    pthread_mutex_unlock(&s->lock);
+
+    atomic_fetch_add_explicit(&s->st_parse_ns, spent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->st_flushes, 1, memory_order_relaxed);
+    session_ring_notify(s, &s->ring_space_cv);
+
+    if (!atomic_exchange(&s->output_pending, 1)) evloop_wake(s->app);
+
+    // pthread の mutex は公平ではないので、UI が待っている間は取り直さない
+    if (tail != head || atomic_load(&s->ui_waiting)) {
+      atomic_fetch_add_explicit(&s->st_yields, 1, memory_order_relaxed);
+      while (atomic_load(&s->ui_waiting) && !atomic_load(&s->stop)) sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void session_out_append_locked(Session *s, const void *data, size_t n) {
+  PtyOutQueue *q = &s->out;
+
+  // 書き終えた分を前に詰める
+  if (q->off > 0 && q->off == q->len) {
+    q->off = q->len = 0;
+  } else if (q->off > 0 && q->len + n > q->cap) {
+    memmove(q->buf, q->buf + q->off, q->len - q->off);
+    q->len -= q->off;
+    q->off = 0;
+  }
+
+  if (q->len + n > PTY_OUT_MAX) {
+    fprintf(stderr, "session: PTY output queue full, dropping %zu bytes\n", q->len + n - PTY_OUT_MAX);
+    n = PTY_OUT_MAX - q->len;
+    if (n == 0) return;
+  }
+
+  if (q->len + n > q->cap) {
+    size_t newcap = q->cap ? q->cap : 1024;
+    while (newcap < q->len + n) newcap *= 2;
+    char *nb = (char*)realloc(q->buf, newcap);
+    if (!nb) return;
+    q->buf = nb;
+    q->cap = newcap;
+  }
+
+  memcpy(q->buf + q->len, data, n);
+  q->len += n;
+}
+
+// libvterm が端末へ返す応答（DSR・DA・括弧付き貼り付けのマーカーなど）
+static void session_cb_output(const char *bytes, size_t len, void *user) {
+  Session *s = (Session*)user;
+  if (s->pty_fd < 0 || len == 0) return;
+
+  pthread_mutex_lock(&s->out_mtx);
+  session_out_append_locked(s, bytes, len);
+  pthread_mutex_unlock(&s->out_mtx);
+
+  // 解析スレッドから呼ばれた時は UI スレッドに書いてもらう
+  evloop_wake(s->app);
+}
+
+// 相手が眠りに入る直前の判定とすれ違わないよう ring_mtx を取ってから起こす
+static void session_ring_notify(Session *s, pthread_cond_t *cv) {
+  pthread_mutex_lock(&s->ring_mtx);
+  pthread_cond_signal(cv);
+  pthread_mutex_unlock(&s->ring_mtx);
 }
 
 static void session_start_shell(Session *s) {
@@ -145,62 +561,68 @@ static void session_init_vterm(Session *s) {
   s->vt = vterm_new(TERM_ROWS, TERM_COLS);
   vterm_set_utf8(s->vt, 1);
 
+  vterm_output_set_callback(s->vt, session_cb_output, s);
+
+#ifdef GKD_VTERM_STATE_BACKEND
+  // VTermScreen は作らず、状態コールバックで grid.c の画面に直接書く
+  s->vts_state = vterm_obtain_state(s->vt);
+  grid_attach(s);
+  vterm_state_set_unrecognised_fallbacks(s->vts_state, &fallbacks_cb, s);
+  vterm_state_reset(s->vts_state, 1);
+#else
   s->vts = vterm_obtain_screen(s->vt);
   s->vts_state = vterm_obtain_state(s->vt);
 
   vterm_screen_set_callbacks(s->vts, &screen_cb, s);
   vterm_screen_callbacks_has_pushline4(s->vts);
 
+  vterm_screen_set_unrecognised_fallbacks(s->vts, &fallbacks_cb, s);
+
   vterm_screen_set_damage_merge(s->vts, VTERM_DAMAGE_SCROLL);
   vterm_screen_reset(s->vts, 1);
+#endif
+  term_apply_theme(s);
 }
 
-static int session_cb_sb_clear(void *user) {
-  Session *s = (Session*)user;
-  s->sb_head = 0;
-  s->sb_count = 0;
-  s->view_offset_lines = 0;
-  memset(s->sb_cont, 0, sizeof(s->sb_cont));
-  return 1;
+static int session_cb_osc(int command, VTermStringFragment frag, void *user) {
+  return term_osc_palette((Session*)user, command, frag);
 }
 
-static int session_cb_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user) {
+#ifndef GKD_VTERM_STATE_BACKEND
+static int session_cb_damage(VTermRect rect, void *user) {
   Session *s = (Session*)user;
 
-  ScrollbackCell *dst = s->sb_buf[s->sb_head];
-
-  int maxc = cols;
-  if (maxc > TERM_COLS) maxc = TERM_COLS;
-
-  for (int c = 0; c < maxc; c++) {
-    const VTermScreenCell *cell = &cells[c];
-    ScrollbackCell out;
-
-    out.width = (uint8_t)cell->width;
-    
-    if (cell->width == 0) {
-      out.ch = 0;
-    } else {
-      out.ch = cell->chars[0] ? cell->chars[0] : ' ';
-      if (out.ch == 0) out.ch = ' ';
-    }
+  int r0 = rect.start_row < 0 ? 0 : rect.start_row;
+  int r1 = rect.end_row > TERM_ROWS ? TERM_ROWS : rect.end_row;
+  for (int r = r0; r < r1; r++) s->dirty_rows[r] = s->screen_stale[r] = 1;
+  return 1;
+}
 
-    out.fg = term_fg_to_sdl(s->app, s->vts_state, cell->fg);
-    out.bg = term_bg_to_sdl(s->app, s->vts_state, cell->bg);
-    out.reverse = cell->attrs.reverse ? 1 : 0;
+// 行ごとの上下のスクロールだけ引き受ける（描画側がテクスチャをずらして済ませる）。
+// 横方向や一部の桁だけの移動は 0 を返して libvterm に damage にしてもらう
+static int session_cb_moverect(VTermRect dest, VTermRect src, void *user) {
+  if (src.start_col != 0 || src.end_col != TERM_COLS || dest.start_col != 0 || dest.end_col != TERM_COLS) return 0;
 
-    dst[c] = out;
-  }
+  term_screen_move_rows((Session*)user, dest.start_row, src.start_row, src.end_row - src.start_row);
+  return 1;
+}
 
-  for (int c = maxc; c < TERM_COLS; c++) {
-    dst[c] = (ScrollbackCell){ .ch=' ', .fg=s->app->render.def_fg, .bg=s->app->render.def_bg, .width=1, .reverse=0 };
-  }
+static int session_cb_sb_clear(void *user) {
+  Session *s = (Session*)user;
+  sb_store_clear(s);
+  s->view_offset_lines = 0;
+  return 1;
+}
 
-  s->sb_cont[s->sb_head] = continuation ? 1 : 0;
+static int session_cb_sb_pushline4(int cols, const VTermScreenCell *cells, bool continuation, void *user) {
+  Session *s = (Session*)user;
+  uint64_t t0 = util_now_ns();
 
-  s->sb_head = (s->sb_head + 1) % SCROLLBACK_LINES;
-  if (s->sb_count < SCROLLBACK_LINES) s->sb_count++;
+  ScrollbackCell *dst = sb_store_push(s, continuation);
+  if (dst) sb_line_pack(s, dst, cells, cols);
 
+  atomic_fetch_add_explicit(&s->st_push_ns, util_now_ns() - t0, memory_order_relaxed);
+  atomic_fetch_add_explicit(&s->st_pushes, 1, memory_order_relaxed);
   return 1;
 }
-
+#endif
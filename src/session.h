@@ -6,5 +6,13 @@ int session_create(App *app, int idx);
 void session_destroy(App *app, int idx);
 void session_switch(App *app, int idx);
 int sessions_pump_io(App *app);
+void session_out_append(Session *s, const void *data, size_t n);
+void session_paste_start(Session *s, const char *text, size_t len);
+int session_paste_progress(const Session *s);
+void sessions_flush_output(App *app);
+void sessions_lock_all(App *app);
+void sessions_unlock_all(App *app);
+void session_lock(Session *s);
+void session_unlock(Session *s);
 int sessions_alive_count(App *app);
 int session_find_next_alive(App *app, int from);
@@ -0,0 +1,111 @@
+#include "stats.h"
+#include "session.h"
+
+#include <stdio.h>
+
+static double stats_per_frame(Uint32 v, Uint32 frames);
+static void stats_log_pty(App *app, Uint32 elapsed_ms);
+
+void stats_tick(App *app) {
+  Uint32 now = SDL_GetTicks();
+  Stats *st = &app->stats;
+
+  if (st->since == 0) st->since = now;
+  if (now - st->since < STATS_LOG_INTERVAL_MS) return;
+
+  Uint32 elapsed_ms = now - st->since;
+  stats_log_pty(app, elapsed_ms);
+  if (app->cfg.stats_log && st->frames > 0) {
+    // render= は経過時間のうち描画に使った割合。ff_kbps=0 の時と比べると早送りの効き目が分かる
+    fprintf(stderr,
+            "stats: frames=%u (full=%u partial=%u ff=%u) coalesced=%u frame_avg=%.2f ms frame_max=%.2f ms render=%.1f%%\n",
+            st->frames, st->full_frames, st->partial_frames, st->ff_frames, st->coalesced,
+            stats_per_frame(st->frame_us, st->frames) / 1000.0, st->frame_us_max / 1000.0,
+            elapsed_ms ? st->frame_us / 10.0 / elapsed_ms : 0.0);
+    fprintf(stderr,
+            "stats: rows/frame=%.1f blitted/frame=%.1f fill_calls/frame=%.1f fill_rects/frame=%.1f geometry/frame=%.1f\n",
+            stats_per_frame(st->rows_drawn, st->frames),
+            stats_per_frame(st->rows_blitted, st->frames),
+            stats_per_frame(st->fill_calls, st->frames),
+            stats_per_frame(st->fill_rects, st->frames),
+            stats_per_frame(st->geometry_calls, st->frames));
+  }
+  if (app->cfg.stats_log) {
+    fprintf(stderr, "stats: wakeups=%u pty_writes=%u pty_write_bytes=%u\n",
+            st->wakeups, st->pty_writes, st->pty_write_bytes);
+
+    const StrCache *sc = &app->render.strcache;
+    fprintf(stderr, "stats: strcache hits=%u misses=%u evictions=%u bytes=%zu\n",
+            sc->hits, sc->misses, sc->evictions, sc->bytes);
+
+    const RenderResources *rr = &app->render;
+    fprintf(stderr, "stats: glyphs entries=%d pages=%d hits=%u misses=%u evicted=%u page_evictions=%u\n",
+            rr->glyph_count, rr->atlas_pages, rr->glyph_hits, rr->glyph_misses,
+            rr->glyph_evictions, rr->glyph_page_evictions);
+
+    int sb_lines = 0, sb_blocks = 0, sb_colors = 0;
+    uint32_t sb_fallbacks = 0;
+    size_t sb_bytes = 0;
+    uint64_t sb_spill = 0;
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+      Session *s = &app->sessions[i];
+      if (!s->used) continue;
+      session_lock(s);
+      sb_lines += s->sb_count;
+      sb_blocks += s->sb_cold_count;
+      sb_bytes += s->sb_cold_bytes + (size_t)s->sb_cap * TERM_COLS * sizeof(ScrollbackCell);
+      sb_spill += s->sb_spill_size;
+      sb_colors += s->sb_colors.count - s->sb_colors.free_count;
+      sb_fallbacks += s->sb_colors.fallbacks;
+      s->sb_colors.fallbacks = 0;
+      session_unlock(s);
+    }
+    fprintf(stderr, "stats: scrollback lines=%d cold_blocks=%d bytes=%zu KiB spill=%llu KiB rgb_colors=%d quantized=%u\n",
+            sb_lines, sb_blocks, sb_bytes / 1024, (unsigned long long)(sb_spill / 1024),
+            sb_colors, sb_fallbacks);
+  }
+
+  *st = (Stats){0};
+  st->since = now;
+}
+
+// セッションスレッドの PTY 計測を回収する（stats_log 無効でもゼロに戻す）。
+// parse は vterm_input_write に掛かった時間あたりの処理量
+static void stats_log_pty(App *app, Uint32 elapsed_ms) {
+  uint64_t bytes = 0, parse_ns = 0, push_ns = 0;
+  Uint32 reads = 0, flushes = 0, yields = 0, pushes = 0;
+
+  for (int i = 0; i < MAX_SESSIONS; i++) {
+    Session *s = &app->sessions[i];
+    if (!s->used) continue;
+    bytes += atomic_exchange(&s->st_read_bytes, 0);
+    reads += atomic_exchange(&s->st_reads, 0);
+    flushes += atomic_exchange(&s->st_flushes, 0);
+    parse_ns += atomic_exchange(&s->st_parse_ns, 0);
+    yields += atomic_exchange(&s->st_yields, 0);
+    push_ns += atomic_exchange(&s->st_push_ns, 0);
+    pushes += atomic_exchange(&s->st_pushes, 0);
+  }
+
+  if (!app->cfg.stats_log || bytes == 0) return;
+
+  double secs = elapsed_ms / 1000.0;
+  fprintf(stderr, "stats: output=%.1f KiB/s bytes=%llu reads=%u avg_read=%.0f flushes=%u yields=%u parse=%.1f MiB/s backend=%s\n",
+          secs > 0 ? bytes / 1024.0 / secs : 0.0,
+          (unsigned long long)bytes,
+          reads, reads ? (double)bytes / reads : 0.0,
+          flushes, yields,
+          parse_ns ? (bytes / 1048576.0) / (parse_ns / 1e9) : 0.0,
+          VTERM_BACKEND_NAME);
+
+  // scrollback への押し出しは parse の内数。1行あたりと parse に占める割合
+  if (pushes) {
+    fprintf(stderr, "stats: pushline lines=%u avg=%.0f ns share=%.1f%%\n",
+            pushes, (double)push_ns / pushes,
+            parse_ns ? 100.0 * (double)push_ns / (double)parse_ns : 0.0);
+  }
+}
+
+static double stats_per_frame(Uint32 v, Uint32 frames) {
+  return frames ? (double)v / (double)frames : 0.0;
+}
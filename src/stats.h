@@ -0,0 +1,5 @@
+#pragma once
+
+#include "app.h"
+
+void stats_tick(App *app);
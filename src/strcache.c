@@ -0,0 +1,172 @@
+#include "strcache.h"
+
+#include <string.h>
+
+static uint32_t strcache_hash(const char *s);
+static StrCacheEntry *strcache_find(StrCache *c, const char *s, uint32_t h, const SDL_Color *fg);
+static StrCacheEntry *strcache_alloc(App *app);
+static void strcache_release(StrCache *c, StrCacheEntry *e);
+static void strcache_evict_lru(App *app, int textures_only);
+static int strcache_same_color(SDL_Color a, SDL_Color b);
+
+void strcache_clear(App *app) {
+  StrCache *c = &app->render.strcache;
+  for (int i = 0; i < STRCACHE_ENTRIES; i++) {
+    strcache_release(c, &c->entries[i]);
+  }
+  c->bytes = 0;
+}
+
+// 描画済みテクスチャを返す。キャッシュできない長さなら NULL（呼び出し側で直接描く）
+SDL_Texture *strcache_get_texture(App *app, const char *s, SDL_Color fg, int *out_w, int *out_h) {
+  StrCache *c = &app->render.strcache;
+  if (!s || !s[0] || strlen(s) >= STRCACHE_TEXT_MAX) return NULL;
+
+  uint32_t h = strcache_hash(s);
+  StrCacheEntry *e = strcache_find(c, s, h, &fg);
+  if (e && e->tex) {
+    c->hits++;
+    e->last_used = ++c->clock;
+    *out_w = e->w;
+    *out_h = e->h;
+    return e->tex;
+  }
+  c->misses++;
+
+  SDL_Surface *surf = TTF_RenderUTF8_Blended(app->font, s, fg);
+  if (!surf) return NULL;
+
+  size_t need = (size_t)surf->w * (size_t)surf->h * 4;
+  while (c->bytes + need > STRCACHE_MEM_CAP && c->bytes > 0) {
+    strcache_evict_lru(app, 1);
+  }
+
+  // 同じ文字列の幅だけのエントリがあればそれを使う
+  if (!e) e = strcache_find(c, s, h, NULL);
+  if (e && e->tex) e = NULL;
+  if (!e) e = strcache_alloc(app);
+
+  SDL_Texture *tex = SDL_CreateTextureFromSurface(app->renderer, surf);
+  if (!tex) { SDL_FreeSurface(surf); return NULL; }
+  SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+
+  strcpy(e->text, s);
+  e->hash = h;
+  e->fg = fg;
+  e->tex = tex;
+  e->w = surf->w;
+  e->h = surf->h;
+  e->used = 1;
+  e->last_used = ++c->clock;
+  c->bytes += need;
+
+  SDL_FreeSurface(surf);
+
+  *out_w = e->w;
+  *out_h = e->h;
+  return tex;
+}
+
+// TTF_SizeUTF8 の結果をキャッシュする（色は問わない）
+int strcache_get_size(App *app, const char *s, int *out_w, int *out_h) {
+  StrCache *c = &app->render.strcache;
+  *out_w = 0;
+  *out_h = 0;
+  if (!s || !s[0]) return 0;
+
+  if (strlen(s) >= STRCACHE_TEXT_MAX) {
+    return TTF_SizeUTF8(app->font, s, out_w, out_h);
+  }
+
+  uint32_t h = strcache_hash(s);
+  StrCacheEntry *e = strcache_find(c, s, h, NULL);
+  if (e) {
+    c->hits++;
+    e->last_used = ++c->clock;
+    *out_w = e->w;
+    *out_h = e->h;
+    return 0;
+  }
+  c->misses++;
+
+  int w = 0, th = 0;
+  if (TTF_SizeUTF8(app->font, s, &w, &th) != 0) return -1;
+
+  e = strcache_alloc(app);
+  strcpy(e->text, s);
+  e->hash = h;
+  e->fg = (SDL_Color){0, 0, 0, 0};
+  e->tex = NULL;
+  e->w = w;
+  e->h = th;
+  e->used = 1;
+  e->last_used = ++c->clock;
+
+  *out_w = w;
+  *out_h = th;
+  return 0;
+}
+
+static StrCacheEntry *strcache_find(StrCache *c, const char *s, uint32_t h, const SDL_Color *fg) {
+  for (int i = 0; i < STRCACHE_ENTRIES; i++) {
+    StrCacheEntry *e = &c->entries[i];
+    if (!e->used || e->hash != h) continue;
+    if (fg && (!e->tex || !strcache_same_color(e->fg, *fg))) continue;
+    if (strcmp(e->text, s) == 0) return e;
+  }
+  return NULL;
+}
+
+static StrCacheEntry *strcache_alloc(App *app) {
+  StrCache *c = &app->render.strcache;
+  for (int i = 0; i < STRCACHE_ENTRIES; i++) {
+    if (!c->entries[i].used) return &c->entries[i];
+  }
+
+  strcache_evict_lru(app, 0);
+  for (int i = 0; i < STRCACHE_ENTRIES; i++) {
+    if (!c->entries[i].used) return &c->entries[i];
+  }
+  return &c->entries[0];
+}
+
+static void strcache_release(StrCache *c, StrCacheEntry *e) {
+  if (e->tex) {
+    SDL_DestroyTexture(e->tex);
+    c->bytes -= (size_t)e->w * (size_t)e->h * 4;
+  }
+  *e = (StrCacheEntry){0};
+}
+
+static void strcache_evict_lru(App *app, int textures_only) {
+  StrCache *c = &app->render.strcache;
+  StrCacheEntry *victim = NULL;
+
+  for (int i = 0; i < STRCACHE_ENTRIES; i++) {
+    StrCacheEntry *e = &c->entries[i];
+    if (!e->used) continue;
+    if (textures_only && !e->tex) continue;
+    if (!victim || (int32_t)(e->last_used - victim->last_used) < 0) victim = e;
+  }
+
+  if (!victim) {
+    c->bytes = 0;   // 念のため（計上ずれで無限ループしない）
+    return;
+  }
+  strcache_release(c, victim);
+  c->evictions++;
+}
+
+static int strcache_same_color(SDL_Color a, SDL_Color b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+// FNV-1a
+static uint32_t strcache_hash(const char *s) {
+  uint32_t h = 2166136261u;
+  for (const unsigned char *p = (const unsigned char*)s; *p; p++) {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
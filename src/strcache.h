@@ -0,0 +1,7 @@
+#pragma once
+
+#include "app.h"
+
+void strcache_clear(App *app);
+SDL_Texture *strcache_get_texture(App *app, const char *s, SDL_Color fg, int *out_w, int *out_h);
+int strcache_get_size(App *app, const char *s, int *out_w, int *out_h);
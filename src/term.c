@@ -1,20 +1,183 @@
 #include "term.h"
 
 #include "input.h"
+#include "scrollback.h"
+#include "session.h"
 
+#ifdef GKD_VTERM_STATE_BACKEND
+#include "grid.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static void term_pty_send_str(App* app, const char *s);
 static SDL_Color term_color_to_rgb(VTermState *st, VTermColor c);
+static void term_palette_rebuild(Session *s);
+static void term_osc_apply(Session *s, int command, char *args);
+static int term_parse_hex_channel(const char *p, size_t n, uint8_t *out);
+
+// libvterm の既定の ANSI 16色（OSC 104 で戻す先。テーマで上書きされていなければこれ）
+static const SDL_Color term_ansi_default[16] = {
+  {  0,   0,   0, 255}, {224,   0,   0, 255}, {  0, 224,   0, 255}, {224, 224,   0, 255},
+  {  0,   0, 224, 255}, {224,   0, 224, 255}, {  0, 224, 224, 255}, {224, 224, 224, 255},
+  {128, 128, 128, 255}, {255,  64,  64, 255}, { 64, 255,  64, 255}, {255, 255,  64, 255},
+  { 64,  64, 255, 255}, {255,  64, 255, 255}, { 64, 255, 255, 255}, {255, 255, 255, 255},
+};
+
+SDL_Color term_ansi_default_color(int i) {
+  return term_ansi_default[i & 15];
+}
+
+// 画面の1行。damage を受けた行だけ libvterm から取り直す（lock 下で呼ぶ）
+const ScreenCell *term_screen_row(Session *s, int row) {
+  ScreenCell *dst = s->screen_rows[row];
+  if (!s->screen_stale[row]) return dst;
+
+  App *app = s->app;
+#ifdef GKD_VTERM_STATE_BACKEND
+  const ScrollbackCell *src = grid_row(s, row);
+  for (int c = 0; c < TERM_COLS; c++) {
+    ScrollbackCell v = src[c];
+    int width = sb_cell_width(v);
+    dst[c] = (ScreenCell){
+      .ch = width ? sb_cell_cp(v) : 0,
+      .fg = sb_color_to_sdl(app, s, sb_cell_fg(v)),
+      .bg = sb_color_to_sdl(app, s, sb_cell_bg(v)),
+      .width = (uint8_t)width,
+      .attrs = sb_cell_attrs(v),
+    };
+  }
+#else
+  VTermPos pos = { .row = row, .col = 0 };
+  for (int c = 0; c < TERM_COLS; c++) {
+    VTermScreenCell cell;
+    pos.col = c;
+    if (!vterm_screen_get_cell(s->vts, pos, &cell)) {
+      dst[c] = (ScreenCell){ .ch = ' ', .fg = app->render.def_fg, .bg = app->render.def_bg, .width = 1 };
+      continue;
+    }
+
+    dst[c].width = (uint8_t)cell.width;
+    dst[c].ch = cell.width == 0 ? 0 : (cell.chars[0] ? cell.chars[0] : ' ');
+    dst[c].fg = term_fg_to_sdl(app, s, cell.fg);
+    dst[c].bg = term_bg_to_sdl(app, s, cell.bg);
+    dst[c].attrs = term_cell_attrs(&cell);
+  }
+#endif
+
+  s->screen_stale[row] = 0;
+  return dst;
+}
+
+// 行ごとの上下移動（moverect）。キャッシュ・汚れ・内容IDを行と一緒に動かし、
+// 空いた行には新しい ID を振る（libvterm の erase で damage も来る）
+void term_screen_move_rows(Session *s, int dst, int src, int n) {
+  if (n <= 0 || dst == src) return;
+
+  memmove(s->screen_rows[dst], s->screen_rows[src], (size_t)n * sizeof(s->screen_rows[0]));
+  memmove(&s->screen_stale[dst], &s->screen_stale[src], (size_t)n);
+  memmove(&s->dirty_rows[dst], &s->dirty_rows[src], (size_t)n);
+  memmove(&s->screen_row_id[dst], &s->screen_row_id[src], (size_t)n * sizeof(s->screen_row_id[0]));
 
-SDL_Color term_fg_to_sdl(App* app, VTermState *st, VTermColor c) {
+  for (int r = src; r < src + n; r++) {
+    if (r >= dst && r < dst + n) continue;
+    s->screen_row_id[r] = s->screen_id_next++;
+    s->screen_stale[r] = s->dirty_rows[r] = 1;
+  }
+}
+
+// パレット色はセッションの LUT を引くだけ
+SDL_Color term_fg_to_sdl(App* app, const Session *s, VTermColor c) {
   if (c.type == VTERM_COLOR_DEFAULT_FG) return app->render.def_fg;
-  return term_color_to_rgb(st, c);
+  if (VTERM_COLOR_IS_INDEXED(&c)) return s->palette[c.indexed.idx];
+  return (SDL_Color){c.rgb.red, c.rgb.green, c.rgb.blue, 255};
 }
 
-SDL_Color term_bg_to_sdl(App* app, VTermState *st, VTermColor c) {
+SDL_Color term_bg_to_sdl(App* app, const Session *s, VTermColor c) {
   if (c.type == VTERM_COLOR_DEFAULT_BG) return app->render.def_bg;
-  return term_color_to_rgb(st, c);
+  if (VTERM_COLOR_IS_INDEXED(&c)) return s->palette[c.indexed.idx];
+  return (SDL_Color){c.rgb.red, c.rgb.green, c.rgb.blue, 255};
+}
+
+// config.ini のテーマを libvterm に渡し、パレットを作り直す
+void term_apply_theme(Session *s) {
+  const AppConfig *cfg = &s->app->cfg;
+
+  VTermColor fg, bg;
+  vterm_color_rgb(&fg, cfg->theme_fg.r, cfg->theme_fg.g, cfg->theme_fg.b);
+  vterm_color_rgb(&bg, cfg->theme_bg.r, cfg->theme_bg.g, cfg->theme_bg.b);
+  vterm_state_set_default_colors(s->vts_state, &fg, &bg);
+
+  for (int i = 0; i < 16; i++) {
+    SDL_Color t = (cfg->theme_set & (1u << i)) ? cfg->theme[i] : term_ansi_default[i];
+    VTermColor c;
+    vterm_color_rgb(&c, t.r, t.g, t.b);
+    vterm_state_set_palette_color(s->vts_state, i, &c);
+  }
+
+  term_palette_rebuild(s);
+}
+
+// OSC 4（パレット設定）と OSC 104（パレットを戻す）。分割されて届くので final まで貯める
+int term_osc_palette(Session *s, int command, VTermStringFragment frag) {
+  if (command != 4 && command != 104) return 0;
+
+  if (frag.initial) s->osc_len = 0;
+  size_t n = frag.len;
+  if (n > (size_t)(OSC_BUF_MAX - 1 - s->osc_len)) n = (size_t)(OSC_BUF_MAX - 1 - s->osc_len);
+  memcpy(s->osc_buf + s->osc_len, frag.str, n);
+  s->osc_len += (int)n;
+
+  if (frag.final) {
+    s->osc_buf[s->osc_len] = '\0';
+    term_osc_apply(s, command, s->osc_buf);
+    s->osc_len = 0;
+  }
+  return 1;
+}
+
+// "#rrggbb" または X11 の "rgb:r/g/b"（各 1〜4 桁の16進）
+int term_parse_color(const char *spec, SDL_Color *out) {
+  uint8_t ch[3];
+
+  if (spec[0] == '#') {
+    if (strlen(spec) != 7) return -1;
+    for (int i = 0; i < 3; i++) {
+      if (term_parse_hex_channel(spec + 1 + i * 2, 2, &ch[i]) != 0) return -1;
+    }
+  } else if (strncmp(spec, "rgb:", 4) == 0) {
+    const char *p = spec + 4;
+    for (int i = 0; i < 3; i++) {
+      size_t n = strcspn(p, "/");
+      if (term_parse_hex_channel(p, n, &ch[i]) != 0) return -1;
+      p += n;
+      if (i < 2) {
+        if (*p != '/') return -1;
+        p++;
+      }
+    }
+    if (*p) return -1;
+  } else {
+    return -1;
+  }
+
+  *out = (SDL_Color){ch[0], ch[1], ch[2], 255};
+  return 0;
+}
+
+// libvterm のセル属性を CELL_ATTR_* に詰める（libvterm は SGR 2 の faint を持たないので DIM は立たない）
+uint8_t term_cell_attrs(const VTermScreenCell *cell) {
+  uint8_t a = 0;
+  if (cell->attrs.bold) a |= CELL_ATTR_BOLD;
+  if (cell->attrs.italic) a |= CELL_ATTR_ITALIC;
+  if (cell->attrs.underline == VTERM_UNDERLINE_DOUBLE) a |= CELL_ATTR_DUNDERLINE;
+  else if (cell->attrs.underline) a |= CELL_ATTR_UNDERLINE;
+  if (cell->attrs.strike) a |= CELL_ATTR_STRIKE;
+  if (cell->attrs.blink) a |= CELL_ATTR_BLINK;
+  if (cell->attrs.reverse) a |= CELL_ATTR_REVERSE;
+  return a;
 }
 
 void term_send_arrow_up(App* app)    { term_pty_send_str(app, "\x1b[A"); }
@@ -23,7 +186,7 @@ void term_send_arrow_right(App* app) { term_pty_send_str(app, "\x1b[C"); }
 void term_send_arrow_left(App* app)  { term_pty_send_str(app, "\x1b[D"); }
 
 void term_pty_send_byte(App* app, unsigned char b) {
-  if (SESSION(app)->pty_fd >= 0) write(SESSION(app)->pty_fd, &b, 1);
+  session_out_append(SESSION(app), &b, 1);
 }
 
 void term_pty_send_byte_with_altmeta(App* app, unsigned char b) {
@@ -32,7 +195,75 @@ void term_pty_send_byte_with_altmeta(App* app, unsigned char b) {
 }
 
 static void term_pty_send_str(App* app, const char *s) {
-  if (SESSION(app)->pty_fd >= 0) write(SESSION(app)->pty_fd, s, strlen(s));
+  session_out_append(SESSION(app), s, strlen(s));
+}
+
+// libvterm が持つパレット（16色＋キューブ＋グレー）を RGB にしておく
+static void term_palette_rebuild(Session *s) {
+  for (int i = 0; i < 256; i++) {
+    VTermColor c;
+    vterm_state_get_palette_color(s->vts_state, i, &c);
+    s->palette[i] = term_color_to_rgb(s->vts_state, c);
+  }
+
+  // 過去の行もパレット番号で持っているので全部描き直す
+  memset(s->dirty_rows, 1, sizeof(s->dirty_rows));
+  memset(s->screen_stale, 1, sizeof(s->screen_stale));
+  s->repaint_seq++;
+}
+
+// args は "idx;spec;idx;spec..."（OSC 4）または "idx;idx..."／空（OSC 104）
+static void term_osc_apply(Session *s, int command, char *args) {
+  if (command == 104) {
+    // 16 色もテーマ（無ければ libvterm の既定）に戻して作り直す（番号指定でも全体を戻す）
+    term_apply_theme(s);
+    return;
+  }
+
+  char *save = NULL;
+  for (char *idx_s = strtok_r(args, ";", &save); idx_s; idx_s = strtok_r(NULL, ";", &save)) {
+    char *spec = strtok_r(NULL, ";", &save);
+    if (!spec) break;
+
+    char *end;
+    long idx = strtol(idx_s, &end, 10);
+    if (*end || idx < 0 || idx > 255) continue;
+
+    SDL_Color col;
+    if (term_parse_color(spec, &col) != 0) continue;   // 問い合わせ "?" は未対応
+
+    // 0..15 は libvterm 側にも入れる（太字の明色化などが同じ色を使うように）
+    if (idx < 16) {
+      VTermColor c;
+      vterm_color_rgb(&c, col.r, col.g, col.b);
+      vterm_state_set_palette_color(s->vts_state, (int)idx, &c);
+    }
+    s->palette[idx] = col;
+  }
+
+  memset(s->dirty_rows, 1, sizeof(s->dirty_rows));
+  memset(s->screen_stale, 1, sizeof(s->screen_stale));
+  s->repaint_seq++;
+}
+
+// 1〜4 桁の16進を 8bit に（X11 と同じく上位を取る）
+static int term_parse_hex_channel(const char *p, size_t n, uint8_t *out) {
+  if (n < 1 || n > 4) return -1;
+
+  unsigned v = 0;
+  for (size_t i = 0; i < n; i++) {
+    char c = p[i];
+    unsigned d;
+    if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+    else if (c >= 'a' && c <= 'f') d = (unsigned)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') d = (unsigned)(c - 'A' + 10);
+    else return -1;
+    v = (v << 4) | d;
+  }
+
+  unsigned max = (1u << (4 * n)) - 1;
+  *out = (uint8_t)((v * 255 + max / 2) / max);
+  return 0;
 }
 
 static SDL_Color term_color_to_rgb(VTermState *st, VTermColor c) {
@@ -2,8 +2,15 @@
 
 #include "app.h"
 
-SDL_Color term_fg_to_sdl(App *app, VTermState *st, VTermColor c);
-SDL_Color term_bg_to_sdl(App *app, VTermState *st, VTermColor c);
+SDL_Color term_fg_to_sdl(App *app, const Session *s, VTermColor c);
+SDL_Color term_bg_to_sdl(App *app, const Session *s, VTermColor c);
+void term_apply_theme(Session *s);
+int term_osc_palette(Session *s, int command, VTermStringFragment frag);
+int term_parse_color(const char *spec, SDL_Color *out);
+SDL_Color term_ansi_default_color(int i);
+uint8_t term_cell_attrs(const VTermScreenCell *cell);
+const ScreenCell *term_screen_row(Session *s, int row);
+void term_screen_move_rows(Session *s, int dst, int src, int n);
 
 void term_send_arrow_up(App* app);
 void term_send_arrow_down(App* app);
@@ -1,8 +1,16 @@
 #include "text.h"
+#include "render.h"
+#include "strcache.h"
 #include <SDL2/SDL_ttf.h>
 #include <stdint.h>
 
 static uint32_t glyph_hash(uint32_t x);
+static uint32_t glyph_key(uint32_t cp, uint8_t style);
+static int glyph_atlas_alloc(App *app, int w, int h, int *out_page, int *out_x, int *out_y);
+static int glyph_atlas_max_pages(App *app);
+static int glyph_cache_evict_lru_page(App *app);
+static void glyph_cache_remove_at(App *app, uint32_t i);
+static int glyph_atlas_page_alloc(GlyphAtlasPage *pg, int w, int h, int *out_x, int *out_y);
 static int try_open_font(App *app, const char *path, int size);
 static int utf8_decode_1(const char *s, uint32_t *out_cp);
 
@@ -37,67 +45,94 @@ int init_font_with_fallbacks(App *app, const char *path, int size) {
 
 void glyph_cache_clear(App* app) {
   for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
-    if (app->render.glyph_cache[i].used && app->render.glyph_cache[i].tex) {
-      SDL_DestroyTexture(app->render.glyph_cache[i].tex);
-    }
     app->render.glyph_cache[i] = (GlyphCacheEntry){0};
   }
+  app->render.glyph_count = 0;
+
+  for (int p = 0; p < app->render.atlas_pages; p++) {
+    if (app->render.atlas[p].tex) SDL_DestroyTexture(app->render.atlas[p].tex);
+    app->render.atlas[p] = (GlyphAtlasPage){0};
+  }
+  app->render.atlas_pages = 0;
+}
+
+SDL_Texture *glyph_atlas_texture(App *app, int page) {
+  if (page < 0 || page >= app->render.atlas_pages) return NULL;
+  return app->render.atlas[page].tex;
 }
 
-SDL_Texture *glyph_get_texture(App* app, uint32_t cp, int *out_w, int *out_h) {
-  if (!out_w || !out_h) return NULL;
-  *out_w = 0; *out_h = 0;
+const GlyphCacheEntry *glyph_lookup(App* app, uint32_t cp, uint8_t style) {
+  RenderResources *rr = &app->render;
 
   if (cp == 0) cp = ' ';
   // 制御文字は空白扱い
   if (cp < 0x20 || cp == 0x7F) cp = ' ';
-
-  uint32_t h = glyph_hash(cp);
-  uint32_t idx = h & (GLYPH_CACHE_SIZE - 1);
-
-  // GLYPH_CACHE_SIZE は 2の冪推奨（4096等）
-  for (uint32_t probe = 0; probe < GLYPH_CACHE_SIZE; probe++) {
-    GlyphCacheEntry *e = &app->render.glyph_cache[idx];
-
-    if (e->used) {
-      if (e->cp == cp) {
-        *out_w = e->w;
-        *out_h = e->h;
-        return e->tex;
-      }
-    } else {
-      // 空きに挿入
-      char utf8[8];
-      utf8_encode_cp(cp, utf8);
-
-      SDL_Color white = {255, 255, 255, 255};
-      // SDL_Surface *surf = TTF_RenderUTF8_Solid(app->font, utf8, white);
-      SDL_Surface *surf = TTF_RenderUTF8_Blended(app->font, utf8, white);
-      if (!surf) return NULL;
-
-      SDL_Texture *tex = SDL_CreateTextureFromSurface(app->renderer, surf);
-      if (!tex) { SDL_FreeSurface(surf); return NULL; }
-
-      SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
-
-      e->used = 1;
-      e->cp = cp;
-      e->tex = tex;
-      e->w = surf->w;
-      e->h = surf->h;
-
-      *out_w = e->w;
-      *out_h = e->h;
-
+  style &= GLYPH_STYLE_MASK;
+
+  // GLYPH_CACHE_SIZE は 2の冪（負荷率を GLYPH_CACHE_MAX_LOAD 以下に保つので必ず空きがある）
+  uint32_t home = glyph_hash(glyph_key(cp, style)) & (GLYPH_CACHE_SIZE - 1);
+  uint32_t idx = home;
+  while (rr->glyph_cache[idx].used) {
+    GlyphCacheEntry *e = &rr->glyph_cache[idx];
+    if (e->cp == cp && e->style == style) {
+      rr->glyph_hits++;
+      rr->atlas[e->page].last_used = ++rr->glyph_clock;
+      return e;
+    }
+    idx = (idx + 1) & (GLYPH_CACHE_SIZE - 1);
+  }
+  rr->glyph_misses++;
+
+  if (rr->glyph_count >= GLYPH_CACHE_MAX_LOAD) glyph_cache_evict_lru_page(app);
+
+  char utf8[8];
+  utf8_encode_cp(cp, utf8);
+
+  // スタイル切替はミス時のラスタライズだけ（描画のたびには切り替えない）
+  SDL_Color white = {255, 255, 255, 255};
+  int ttf_style = TTF_STYLE_NORMAL;
+  if (style & CELL_ATTR_BOLD) ttf_style |= TTF_STYLE_BOLD;
+  if (style & CELL_ATTR_ITALIC) ttf_style |= TTF_STYLE_ITALIC;
+  if (ttf_style != TTF_STYLE_NORMAL) TTF_SetFontStyle(app->font, ttf_style);
+  SDL_Surface *surf = TTF_RenderUTF8_Blended(app->font, utf8, white);
+  if (ttf_style != TTF_STYLE_NORMAL) TTF_SetFontStyle(app->font, TTF_STYLE_NORMAL);
+  if (!surf) return NULL;
+
+  int page, x, y;
+  if (glyph_atlas_alloc(app, surf->w, surf->h, &page, &x, &y) != 0) {
+    // 予算内でページが埋まった: 最も使われていないページを空けて再試行
+    if (glyph_cache_evict_lru_page(app) != 0 ||
+        glyph_atlas_alloc(app, surf->w, surf->h, &page, &x, &y) != 0) {
       SDL_FreeSurface(surf);
-      return tex;
+      return NULL;
     }
+  }
 
-    idx = (idx + 1) & (GLYPH_CACHE_SIZE - 1);
+  // Blended の出力は ARGB8888 なのでそのまま転送できる
+  SDL_Rect dst = { x, y, surf->w, surf->h };
+  if (SDL_UpdateTexture(rr->atlas[page].tex, &dst, surf->pixels, surf->pitch) != 0) {
+    SDL_FreeSurface(surf);
+    return NULL;
   }
 
-  // キャッシュ満杯（本気ならLRU化。まずは諦める）
-  return NULL;
+  // 追い出しでテーブルが動いている可能性があるので挿入位置は探し直す
+  idx = home;
+  while (rr->glyph_cache[idx].used) idx = (idx + 1) & (GLYPH_CACHE_SIZE - 1);
+
+  GlyphCacheEntry *e = &rr->glyph_cache[idx];
+  e->used = 1;
+  e->cp = cp;
+  e->style = style;
+  e->page = (uint8_t)page;
+  e->x = (uint16_t)x;
+  e->y = (uint16_t)y;
+  e->w = (uint16_t)surf->w;
+  e->h = (uint16_t)surf->h;
+  rr->glyph_count++;
+  rr->atlas[page].last_used = ++rr->glyph_clock;
+
+  SDL_FreeSurface(surf);
+  return e;
 }
 
 uint32_t utf8_sanitize_cp(uint32_t c) {
@@ -179,6 +214,133 @@ static uint32_t glyph_hash(uint32_t x) {
   return x;
 }
 
+// コードポイントは 21bit なので上位にスタイルを載せる
+static uint32_t glyph_key(uint32_t cp, uint8_t style) {
+  return cp | ((uint32_t)style << 24);
+}
+
+// 棚（shelf）詰め: 高さの合う棚のうち最も低いものに右へ詰めていく
+static int glyph_atlas_alloc(App *app, int w, int h, int *out_page, int *out_x, int *out_y) {
+  w += GLYPH_ATLAS_PADDING;
+  h += GLYPH_ATLAS_PADDING;
+  if (w > GLYPH_ATLAS_SIZE || h > GLYPH_ATLAS_SIZE) return -1;
+
+  for (int p = 0; p < app->render.atlas_pages; p++) {
+    if (glyph_atlas_page_alloc(&app->render.atlas[p], w, h, out_x, out_y) == 0) {
+      *out_page = p;
+      return 0;
+    }
+  }
+
+  if (app->render.atlas_pages >= glyph_atlas_max_pages(app)) return -1;
+
+  GlyphAtlasPage *pg = &app->render.atlas[app->render.atlas_pages];
+  *pg = (GlyphAtlasPage){0};
+  pg->tex = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                              GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE);
+  if (!pg->tex) {
+    fprintf(stderr, "Glyph atlas allocation failed: %s\n", SDL_GetError());
+    return -1;
+  }
+  SDL_SetTextureBlendMode(pg->tex, SDL_BLENDMODE_BLEND);
+  app->render.atlas_pages++;
+
+  if (glyph_atlas_page_alloc(pg, w, h, out_x, out_y) != 0) return -1;
+  *out_page = app->render.atlas_pages - 1;
+  return 0;
+}
+
+static int glyph_atlas_max_pages(App *app) {
+  long pages = (long)app->cfg.glyph_cache_kb * 1024 / GLYPH_ATLAS_PAGE_BYTES;
+  if (pages < 1) pages = 1;
+  if (pages > GLYPH_ATLAS_PAGES) pages = GLYPH_ATLAS_PAGES;
+  return (int)pages;
+}
+
+// 最も長く使われていないページのグリフを全て捨て、ページを空にする。
+// 棚詰めでは個々のグリフの穴を再利用しにくいので、追い出しはページ単位で行う
+static int glyph_cache_evict_lru_page(App *app) {
+  RenderResources *rr = &app->render;
+  if (rr->atlas_pages == 0) return -1;
+
+  int victim = 0;
+  for (int p = 1; p < rr->atlas_pages; p++) {
+    if ((int32_t)(rr->atlas[p].last_used - rr->atlas[victim].last_used) < 0) victim = p;
+  }
+
+  // 積んであるクアッドが追い出すページを参照しているかもしれないので先に描く
+  render_cells_flush(app);
+
+  for (uint32_t i = 0; i < GLYPH_CACHE_SIZE; ) {
+    GlyphCacheEntry *e = &rr->glyph_cache[i];
+    if (e->used && e->page == victim) {
+      glyph_cache_remove_at(app, i);   // 後続が詰められるので同じ位置をもう一度見る
+      rr->glyph_evictions++;
+      continue;
+    }
+    i++;
+  }
+
+  GlyphAtlasPage *pg = &rr->atlas[victim];
+  pg->shelf_count = 0;
+  pg->next_y = 0;
+  rr->glyph_page_evictions++;
+  return 0;
+}
+
+// 線形探査テーブルからの削除（墓標を使わず、後続のエントリを後方シフトで詰める）
+static void glyph_cache_remove_at(App *app, uint32_t i) {
+  GlyphCacheEntry *t = app->render.glyph_cache;
+  const uint32_t mask = GLYPH_CACHE_SIZE - 1;
+  uint32_t hole = i;
+  uint32_t j = i;
+
+  for (;;) {
+    j = (j + 1) & mask;
+    if (!t[j].used) break;
+
+    // 本来の位置が (hole, j] にあるエントリは動かせない
+    uint32_t home = glyph_hash(glyph_key(t[j].cp, t[j].style)) & mask;
+    if (((j - home) & mask) < ((j - hole) & mask)) continue;
+
+    t[hole] = t[j];
+    hole = j;
+  }
+
+  t[hole] = (GlyphCacheEntry){0};
+  app->render.glyph_count--;
+}
+
+static int glyph_atlas_page_alloc(GlyphAtlasPage *pg, int w, int h, int *out_x, int *out_y) {
+  GlyphAtlasShelf *best = NULL;
+  for (int i = 0; i < pg->shelf_count; i++) {
+    GlyphAtlasShelf *sh = &pg->shelves[i];
+    if (sh->h < h || sh->x + w > GLYPH_ATLAS_SIZE) continue;
+    if (!best || sh->h < best->h) best = sh;
+  }
+
+  // 高すぎる棚に入れると無駄が多いので、その場合は新しい棚を優先
+  if (best && best->h > h + h / 2 && pg->shelf_count < GLYPH_ATLAS_MAX_SHELVES &&
+      pg->next_y + h <= GLYPH_ATLAS_SIZE) {
+    best = NULL;
+  }
+
+  if (!best) {
+    if (pg->shelf_count >= GLYPH_ATLAS_MAX_SHELVES) return -1;
+    if (pg->next_y + h > GLYPH_ATLAS_SIZE) return -1;
+    best = &pg->shelves[pg->shelf_count++];
+    best->y = pg->next_y;
+    best->h = h;
+    best->x = 0;
+    pg->next_y += h;
+  }
+
+  *out_x = best->x;
+  *out_y = best->y;
+  best->x += w;
+  return 0;
+}
+
 static int try_open_font(App *app, const char *path, int size) {
   if (!path || !path[0]) return -1;
 
@@ -191,6 +353,7 @@ static int try_open_font(App *app, const char *path, int size) {
     app->font = NULL;
   }
   glyph_cache_clear(app);
+  strcache_clear(app);
 
   app->font = f;
 
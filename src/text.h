@@ -7,7 +7,8 @@
 int init_font_with_fallbacks(App *app, const char *path, int size);
 
 void glyph_cache_clear(App *app);
-SDL_Texture *glyph_get_texture(App *app, uint32_t cp, int *out_w, int *out_h);
+const GlyphCacheEntry *glyph_lookup(App *app, uint32_t cp, uint8_t style);
+SDL_Texture *glyph_atlas_texture(App *app, int page);
 
 uint32_t utf8_sanitize_cp(uint32_t c);
 int utf8_encode_cp(uint32_t c, char out[8]);
@@ -4,7 +4,9 @@
 #include "clipboard.h"
 #include "screenshot.h"
 #include "session.h"
+#include "strcache.h"
 
+#include <string.h>
 #include <time.h>
 
 static SDL_Color ui_mod_color(ModState st, SDL_Color base);
@@ -13,6 +15,15 @@ static const char *ui_mod_suffix(App* app, ModState st);
 void ui_draw_text_utf8(App* app, int x, int y, SDL_Color fg, const char *s) {
   if (!s || !s[0]) return;
 
+  int tw = 0, th = 0;
+  SDL_Texture *cached = strcache_get_texture(app, s, fg, &tw, &th);
+  if (cached) {
+    SDL_Rect dst = { x, y, tw, th };
+    SDL_RenderCopy(app->renderer, cached, NULL, &dst);
+    return;
+  }
+
+  // キャッシュ対象外（長すぎる文字列）は都度描画
   SDL_Surface *surf = TTF_RenderUTF8_Blended(app->font, s, fg);
   if (!surf) return;
 
@@ -29,12 +40,13 @@ void ui_draw_text_utf8(App* app, int x, int y, SDL_Color fg, const char *s) {
 int ui_text_width_utf8(App* app, const char *s) {
   int w = 0, h = 0;
   if (!s || !s[0]) return 0;
-  if (TTF_SizeUTF8(app->font, s, &w, &h) != 0) return 0;
+  if (strcache_get_size(app, s, &w, &h) != 0) return 0;
   return w;
 }
 
-void ui_draw_session_menu_overlay(App* app) {
-  SDL_Rect r = { MENU_OVERLAY_MARGIN_X, MENU_OVERLAY_MARGIN_Y,
+// (ox, oy): 左上の位置（レイヤテクスチャへ描く時は 0,0）
+void ui_draw_session_menu_overlay(App* app, int ox, int oy) {
+  SDL_Rect r = { ox, oy,
                  SCREEN_W - MENU_OVERLAY_WIDTH_REDUCE, SCREEN_H - MENU_OVERLAY_HEIGHT_REDUCE };
 
   // 背景
@@ -133,7 +145,7 @@ void ui_draw_key_button(App* app, int x0, int y0, int w, int h, const char *labe
   ui_draw_rect_thick_inset(app, &r, selected ? 2 : 1, border);
 
   int tw = 0, th = 0;
-  if (TTF_SizeUTF8(app->font, label, &tw, &th) != 0) return;
+  if (strcache_get_size(app, label, &tw, &th) != 0) return;
 
   // ボタン内にクリップ（はみ出し保険）
   SDL_Rect clip = { x0 + 2, y0 + 2, w - 4, h - 4 };
@@ -203,17 +215,20 @@ void ui_update_timers_and_io(App* app) {
     } else if (now - app->pending.paste_pending_since >= PASTE_DELAY_MS) {
       clipboard_paste(app);
       app->pending.paste_pending = 0;
-      app->need_redraw = 1;
+      app->need_redraw |= REDRAW_ALL;
     }
   }
 
-  if (sessions_pump_io(app)) app->need_redraw = 1;
+  if (sessions_pump_io(app)) {
+    if (app->need_redraw & REDRAW_OUTPUT) app->stats.coalesced++;
+    app->need_redraw |= REDRAW_OUTPUT;
+  }
 
   time_t t = time(NULL);
   struct tm *tm_now = localtime(&t);
   if (tm_now && tm_now->tm_min != app->status_cache.prev_minute) {
     app->status_cache.prev_minute = tm_now->tm_min;
-    app->need_redraw = 1;
+    app->need_redraw |= REDRAW_STATUS;
   }
 
   Uint32 now_ms = SDL_GetTicks();
@@ -222,19 +237,68 @@ void ui_update_timers_and_io(App* app) {
     int b = battery_get_level();
     if (b != app->status_cache.cached_batt) {
       app->status_cache.cached_batt = b;
-      app->need_redraw = 1;
+      app->need_redraw |= REDRAW_STATUS;
     }
   }
 
+  int paste_pct = session_paste_progress(SESSION(app));
+  if (paste_pct != app->status_cache.prev_paste_pct) {
+    app->status_cache.prev_paste_pct = paste_pct;
+    app->need_redraw |= REDRAW_STATUS;
+  }
+
+  // 点滅属性のセルが画面にある時だけ位相の切り替わりで描き直す
+  int text_blink_on = ((now_ms / TEXT_BLINK_HALF_MS) % 2) == 0;
+  if (text_blink_on != app->status_cache.prev_text_blink_on) {
+    app->status_cache.prev_text_blink_on = text_blink_on;
+    if (memchr(app->render.term_row_blink, 1, sizeof(app->render.term_row_blink))) app->need_redraw |= REDRAW_ALL;
+  }
+
   if (!app->ui.menu_active && !SESSION(app)->region_mode) {
     int cursor_on = ((now_ms / CURSOR_BLINK_HALF_MS) % 2) == 0;
     if (cursor_on != app->status_cache.prev_cursor_on) {
       app->status_cache.prev_cursor_on = cursor_on;
-      app->need_redraw = 1;
+      app->need_redraw |= REDRAW_CURSOR;
     }
   }
 }
 
+// 周期タイマが要るか（カーソルや点滅属性のセルが点滅している）。消灯中は要らない
+int ui_needs_tick(App* app) {
+  if (app->backlight.screen_blank) return 0;
+  if (!app->ui.menu_active && !SESSION(app)->region_mode) return 1;
+  return memchr(app->render.term_row_blink, 1, sizeof(app->render.term_row_blink)) != NULL;
+}
+
+// 長押し待ち（スクリーンショット・貼り付け）の期限までの残り ms。無ければ -1。
+// 周期タイマを止めている間は、点いている画面の時計（次の分）と電池の確認の期限も含める
+int ui_next_timeout_ms(App* app) {
+  Uint32 now = SDL_GetTicks();
+  int t = -1;
+
+  if (!app->backlight.screen_blank && !ui_needs_tick(app)) {
+    time_t wall = time(NULL);
+    struct tm *tm_now = localtime(&wall);
+    if (tm_now) t = (60 - tm_now->tm_sec) * 1000;
+
+    Uint32 el = now - app->status_cache.last_batt_tick;
+    int left = (el >= BATT_UPDATE_MS) ? 0 : (int)(BATT_UPDATE_MS - el);
+    if (t < 0 || left < t) t = left;
+  }
+
+  if (app->pending.screenshot_pending) {
+    Uint32 el = now - app->pending.screenshot_pending_since;
+    int left = (el >= SCREENSHOT_DELAY_MS) ? 0 : (int)(SCREENSHOT_DELAY_MS - el);
+    if (t < 0 || left < t) t = left;
+  }
+  if (app->pending.paste_pending) {
+    Uint32 el = now - app->pending.paste_pending_since;
+    int left = (el >= PASTE_DELAY_MS) ? 0 : (int)(PASTE_DELAY_MS - el);
+    if (t < 0 || left < t) t = left;
+  }
+  return t;
+}
+
 int ui_draw_mod_indicator(App *app, int x, int y, SDL_Color base, const char *icon, ModState st) {
   if (st == MOD_OFF) return x;
 
@@ -2,6 +2,15 @@
 
 #include "app.h"
 
+#include <time.h>
+
 static inline int util_is_dpad(int b) {
   return (b >= BTN_UP && b <= BTN_RIGHT);
 }
+
+// スレッドから呼べる単調時計（計測用）
+static inline uint64_t util_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}